@@ -10,13 +10,261 @@
 
 #include <iostream>
 #include <fstream>
-#include <sstream>
 #include <string>
+#include <string_view>
 #include <vector>
+#include <algorithm>
+#include <limits>
+#include <unordered_map>
+#include <deque>
+#include <iterator>
+#include <new>
+#include <cstring>
+#include <cstdint>
+#include <cerrno>
+#include <climits>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <random>
+#include <functional>
+#include <memory>
+#include <ctime>
+#include <cstdlib>
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <xmmintrin.h>
+#endif
+#if defined(__AVX2__) || defined(__SSE4_2__)
+#include <immintrin.h>
+#endif
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#include <io.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 
 
 using namespace std;
 
+//Hint the CPU to start loading address into cache before it is needed
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#define PREFETCH(address) _mm_prefetch(reinterpret_cast<const char*>(address), _MM_HINT_T0)
+#elif defined(__GNUC__)
+#define PREFETCH(address) __builtin_prefetch(address)
+#else
+#define PREFETCH(address) ((void)0)
+#endif
+
+//Number of set bits, used to turn SIMD comparison masks into counts
+#if defined(_MSC_VER)
+#define POPCOUNT(bits) static_cast<int>(__popcnt(bits))
+#else
+#define POPCOUNT(bits) __builtin_popcount(bits)
+#endif
+
+/*
+ * CatalogStats counts what the hot paths do, so a slow catalog can be
+ * explained (menu option 8). The counters are compiled in unless the
+ * program is built with COURSE_STATS=0, then every STAT_ macro compiles
+ * to nothing. Counters are relaxed atomics so ConcurrentCourseTree readers
+ * can bump them without a lock; the recursion depth of the insert or
+ * delete in progress is tracked per thread.
+ */
+#ifndef COURSE_STATS
+#define COURSE_STATS 1
+#endif
+
+struct TreeShape;
+
+struct CatalogStats {
+	atomic<uint64_t> searches{ 0 };
+	atomic<uint64_t> searchComparisons{ 0 };   //Hash probes in the BST, nodes scanned in the B-tree
+	atomic<uint64_t> inserts{ 0 };
+	atomic<uint64_t> insertDepthTotal{ 0 };    //Recursion depth summed over inserts
+	atomic<uint64_t> insertDepthMax{ 0 };
+	atomic<uint64_t> deletes{ 0 };
+	atomic<uint64_t> deleteDepthTotal{ 0 };
+	atomic<uint64_t> deleteDepthMax{ 0 };
+	atomic<uint64_t> dependencyChecks{ 0 };    //Delete dependency checks, one graph lookup each
+	atomic<uint64_t> cycleSearchNodes{ 0 };    //Graph nodes visited by cycle checks and reordering
+	atomic<uint64_t> allocations{ 0 };         //Node (and record) allocations by the catalogs
+	atomic<uint64_t> allocatedBytes{ 0 };
+	atomic<uint64_t> parsedBytes{ 0 };
+	atomic<uint64_t> parseNanos{ 0 };
+	atomic<uint64_t> logRecords{ 0 };         //Operation log records appended
+	atomic<uint64_t> logSyncs{ 0 };           //Group commits (write + fsync) of the operation log
+
+	void RecordDepth(atomic<uint64_t>& count, atomic<uint64_t>& total, atomic<uint64_t>& maximum, uint64_t depth);
+	void Print(ostream& out, const TreeShape& shape) const;
+	bool WriteJson(const string& fileName, const TreeShape& shape) const;
+};
+
+CatalogStats catalogStats; //Shared by every catalog in the program
+
+#if COURSE_STATS
+thread_local uint64_t statDepth = 0; //Recursion depth of this thread's insert or delete
+#define STAT_ADD(counter, amount) (catalogStats.counter.fetch_add((amount), memory_order_relaxed))
+#define STAT_DEPTH_BEGIN() (statDepth = 0)
+#define STAT_DEPTH_STEP() (++statDepth)
+#define STAT_DEPTH_END(count, total, maximum) \
+	catalogStats.RecordDepth(catalogStats.count, catalogStats.total, catalogStats.maximum, statDepth)
+#else
+#define STAT_ADD(counter, amount) ((void)0)
+#define STAT_DEPTH_BEGIN() ((void)0)
+#define STAT_DEPTH_STEP() ((void)0)
+#define STAT_DEPTH_END(count, total, maximum) ((void)0)
+#endif
+
+/*
+ * RecordDepth() counts one finished insert or delete and its recursion depth
+ *
+ * @param count, total, maximum (counters of the operation), uint64_t depth
+ */
+void CatalogStats::RecordDepth(atomic<uint64_t>& count, atomic<uint64_t>& total, atomic<uint64_t>& maximum, uint64_t depth) {
+	count.fetch_add(1, memory_order_relaxed);
+	total.fetch_add(depth, memory_order_relaxed);
+	uint64_t seen = maximum.load(memory_order_relaxed);
+	while (depth > seen && !maximum.compare_exchange_weak(seen, depth, memory_order_relaxed)) {
+	}
+}
+
+/*
+ * TreeShape is filled by CourseCatalog::Shape(): how many courses sit at
+ * each depth (root = 1, a B-tree counts each course at its node's depth).
+ * A balanced tree of n courses has a height near log2(n).
+ */
+struct TreeShape {
+	size_t courses = 0;
+	size_t depthTotal = 0;
+	vector<size_t> depthCounts; //depthCounts[d] courses at depth d
+
+	void Add(size_t depth, size_t count = 1) {
+		if (depthCounts.size() <= depth) {
+			depthCounts.resize(depth + 1, 0);
+		}
+		depthCounts[depth] += count;
+		courses += count;
+		depthTotal += depth * count;
+	}
+	int Height() const { return depthCounts.empty() ? 0 : static_cast<int>(depthCounts.size() - 1); }
+	double AverageDepth() const { return courses == 0 ? 0 : static_cast<double>(depthTotal) / courses; }
+
+	//Height of a perfectly balanced binary tree of the same size
+	int BalancedHeight() const {
+		int height = 0;
+		for (size_t capacity = 0; capacity < courses; capacity = capacity * 2 + 1) {
+			++height;
+		}
+		return height;
+	}
+};
+
+//Mean of total over count, 0 for no samples
+inline double PerOperation(uint64_t total, uint64_t count) {
+	return count == 0 ? 0 : static_cast<double>(total) / count;
+}
+
+/*
+ * Print() writes the tree shape and the counters as a readable report
+ * (menu option 8). The depth histogram bars are scaled to the fullest depth.
+ *
+ * @param ostream& out, TreeShape& shape
+ */
+void CatalogStats::Print(ostream& out, const TreeShape& shape) const {
+	const size_t BAR_WIDTH = 40;
+
+	out << "Courses: " << shape.courses << endl;
+	out << "Tree height: " << shape.Height() << " (a balanced binary tree needs " << shape.BalancedHeight() << ")" << endl;
+	out << "Average depth: " << shape.AverageDepth() << ", max depth: " << shape.Height() << endl;
+	out << "Courses per depth:" << endl;
+	size_t widest = 1;
+	for (size_t count : shape.depthCounts) {
+		widest = max(widest, count);
+	}
+	for (size_t depth = 1; depth < shape.depthCounts.size(); ++depth) {
+		size_t count = shape.depthCounts[depth];
+		size_t bar = (count * BAR_WIDTH + widest - 1) / widest;
+		out << "  " << depth << ": " << string(bar, '#') << " " << count << endl;
+	}
+
+#if COURSE_STATS
+	out << "Searches: " << searches << ", comparisons per search: "
+		<< PerOperation(searchComparisons, searches) << endl;
+	out << "Inserts: " << inserts << ", average depth: " << PerOperation(insertDepthTotal, inserts)
+		<< ", max depth: " << insertDepthMax << endl;
+	out << "Deletes: " << deletes << ", average depth: " << PerOperation(deleteDepthTotal, deletes)
+		<< ", max depth: " << deleteDepthMax << endl;
+	out << "Dependency checks: " << dependencyChecks << endl;
+	out << "Graph nodes visited by cycle checks: " << cycleSearchNodes << endl;
+	out << "Allocations: " << allocations << " (" << allocatedBytes << " bytes)" << endl;
+	out << "Parsed: " << parsedBytes / 1e6 << " MB in " << parseNanos / 1e6 << " ms ("
+		<< PerOperation(parseNanos, parsedBytes) << " ms per MB)" << endl;
+	out << "Log records: " << logRecords << " in " << logSyncs << " syncs ("
+		<< PerOperation(logRecords, logSyncs) << " per sync)" << endl;
+#else
+	out << "Counters are not compiled in (built with COURSE_STATS=0)." << endl;
+#endif
+}
+
+/*
+ * WriteJson() writes the same report as Print() as one JSON object,
+ * for scripts that watch for degenerate trees
+ *
+ * @param string fileName, TreeShape& shape
+ * @return bool false if fileName could not be written
+ */
+bool CatalogStats::WriteJson(const string& fileName, const TreeShape& shape) const {
+	ofstream json(fileName);
+	if (!json.is_open()) {
+		return false;
+	}
+
+	json << "{" << endl;
+	json << "  \"courses\": " << shape.courses << "," << endl;
+	json << "  \"height\": " << shape.Height() << "," << endl;
+	json << "  \"balanced_height\": " << shape.BalancedHeight() << "," << endl;
+	json << "  \"average_depth\": " << shape.AverageDepth() << "," << endl;
+	json << "  \"max_depth\": " << shape.Height() << "," << endl;
+	json << "  \"depth_histogram\": [";
+	for (size_t depth = 1; depth < shape.depthCounts.size(); ++depth) {
+		json << (depth == 1 ? "" : ", ") << shape.depthCounts[depth];
+	}
+	json << "]," << endl;
+	json << "  \"counters_enabled\": " << (COURSE_STATS ? "true" : "false");
+#if COURSE_STATS
+	json << "," << endl;
+	json << "  \"searches\": " << searches << "," << endl;
+	json << "  \"search_comparisons\": " << searchComparisons << "," << endl;
+	json << "  \"inserts\": " << inserts << "," << endl;
+	json << "  \"insert_depth_total\": " << insertDepthTotal << "," << endl;
+	json << "  \"insert_depth_max\": " << insertDepthMax << "," << endl;
+	json << "  \"deletes\": " << deletes << "," << endl;
+	json << "  \"delete_depth_total\": " << deleteDepthTotal << "," << endl;
+	json << "  \"delete_depth_max\": " << deleteDepthMax << "," << endl;
+	json << "  \"dependency_checks\": " << dependencyChecks << "," << endl;
+	json << "  \"cycle_search_nodes\": " << cycleSearchNodes << "," << endl;
+	json << "  \"allocations\": " << allocations << "," << endl;
+	json << "  \"allocated_bytes\": " << allocatedBytes << "," << endl;
+	json << "  \"parsed_bytes\": " << parsedBytes << "," << endl;
+	json << "  \"parse_ns\": " << parseNanos << "," << endl;
+	json << "  \"log_records\": " << logRecords << "," << endl;
+	json << "  \"log_syncs\": " << logSyncs;
+#endif
+	json << endl << "}" << endl;
+	return json.good();
+}
+
 //Structure declarations to hold course information
 struct Course {
 	string courseId;
@@ -25,416 +273,7160 @@ struct Course {
 	string preReq2 = "";
 };
 
+/*
+ * CourseKey packs the first 16 bytes of a courseId (zero padded) into two
+ * big-endian 64-bit integers, so ordering two IDs costs one or two integer
+ * compares instead of a string compare. Course IDs like CSCI300 fit entirely.
+ * IDs of 16 bytes or more can share a key, then CompareCourseIds() falls
+ * back to the full strings. IDs are packed as stored; the menu already
+ * uppercases what the user types.
+ */
+struct CourseKey {
+	static const size_t KEY_BYTES = 16;
+	uint64_t high; //bytes 0-7
+	uint64_t low;  //bytes 8-15
+
+	CourseKey() : high(0), low(0) {}
+	CourseKey(uint64_t highBytes, uint64_t lowBytes) : high(highBytes), low(lowBytes) {}
+	explicit CourseKey(string_view courseId) {
+		high = pack(courseId, 0);
+		low = pack(courseId, 8);
+	}
+
+	//Packs courseId[offset, offset + 8) with the first byte most significant
+	static uint64_t pack(string_view courseId, size_t offset) {
+		uint64_t bytes = 0;
+		for (size_t i = offset; i < offset + 8; ++i) {
+			bytes <<= 8;
+			if (i < courseId.size()) {
+				bytes |= static_cast<unsigned char>(courseId[i]);
+			}
+		}
+		return bytes;
+	}
+};
+
+/*
+ * CompareKeys() orders two packed keys with integer compares only:
+ * < 0 if a sorts first, 0 if the keys tie, > 0 if b sorts first.
+ *
+ * @param CourseKey a, CourseKey b
+ * @return int
+ */
+inline int CompareKeys(const CourseKey& a, const CourseKey& b) {
+	if (a.high != b.high) {
+		return a.high < b.high ? -1 : 1;
+	}
+	if (a.low != b.low) {
+		return a.low < b.low ? -1 : 1;
+	}
+	return 0;
+}
+
+/*
+ * CompareCourseIds() orders two course IDs by their packed keys, and only
+ * reads the strings when the keys tie and an ID is too long to fit in its key.
+ * Hot loops call CompareKeys() first and this only on a tie, so they do not
+ * touch the string at all in the common case.
+ *
+ * @param CourseKey aKey, string_view aId, CourseKey bKey, string_view bId
+ * @return int
+ */
+inline int CompareCourseIds(const CourseKey& aKey, string_view aId, const CourseKey& bKey, string_view bId) {
+	int comparison = CompareKeys(aKey, bKey);
+	if (comparison != 0 || (aId.size() < CourseKey::KEY_BYTES && bId.size() < CourseKey::KEY_BYTES)) {
+		return comparison; //Keys differ, or whole IDs fit in the keys
+	}
+	return aId.compare(bId);
+}
+
 //Structure declaration for tree node
+//The fields read while walking the tree come first so they share a cache line
 struct Node {
-	Course course;
+	CourseKey key; //Packed courseId, compared on the hot paths
 	Node* left;
 	Node* right;
+	int height; //Height of the subtree rooted here (leaf = 1), used for AVL balancing
+	size_t size; //Courses in the subtree rooted here, used for rank and select
+	Course course;
 
 	//default constructor
 	Node() {
 		//child leaves start empty
 		left = nullptr;
 		right = nullptr;
+		height = 1;
+		size = 1;
 	}
 
-	//course node constructor
-	Node(Course aCourse) : Node() {
-		course = aCourse;
+	//course node constructor, takes over the course's strings
+	Node(Course&& aCourse) : Node() {
+		course = move(aCourse);
+		key = CourseKey(course.courseId);
 	}
 };
 
-
-class BinarySearchTree {
+/*
+ * NodePool is the allocator behind every tree Node.
+ * Nodes are carved out of large slabs in order, so nodes inserted together
+ * sit next to each other in memory instead of being scattered across the heap.
+ * Released nodes go onto a free list and are handed out again before the
+ * next slab is touched. ReleaseAll() gives every slab back at once.
+ */
+class NodePool {
 private:
-	Node* root;
+	static const size_t SLAB_NODES = 1024; //Nodes per slab
 
-	void addNode(Node* node, Course course);
-	void inOrder(Node* node);
-	bool courseDependencyCheck(Node* node, string& courseId); //Enhancement for dependency check
-	Node* deleteNode(Node* node, string& courseId); //Enhancement to remove node with balancing
+	//A released node's storage is reused to link the free list
+	struct FreeSlot {
+		FreeSlot* next;
+	};
+
+	vector<Node*> slabs; //Raw storage, SLAB_NODES nodes each
+	size_t slabUsed;     //Nodes handed out from the newest slab
+	FreeSlot* freeList;  //Released nodes waiting to be recycled
 
 public:
+	NodePool();
+	~NodePool();
+	NodePool(const NodePool&) = delete;
+	NodePool& operator=(const NodePool&) = delete;
 
-	BinarySearchTree();
-	~BinarySearchTree();
-	void InOrder();
-	void DisplayNode(Node* node);
-	void InsertCourse(Course course);
-	Course Search(string courseId);
-	bool DeleteCourseWithDependencyCheck(string courseId); //Enhancement called from main to delete course.
+	Node* Acquire(Course&& course);
+	void Release(Node* node);
+	void ReleaseAll();
+};
+
+NodePool::NodePool() {
+	slabUsed = SLAB_NODES; //forces a slab to be allocated on first Acquire()
+	freeList = nullptr;
+}
+
+NodePool::~NodePool() {
+	ReleaseAll();
+}
+
+/*
+ * Acquire() constructs a node for course, taking the storage from the
+ * free list if a node has been released, otherwise from the current slab.
+ * The course is moved into the node, so its strings are not copied.
+ *
+ * @param Course&& course
+ * @return Node* new leaf node
+ */
+Node* NodePool::Acquire(Course&& course) {
+	void* storage;
+
+	if (freeList != nullptr) { //Recycle a released node first
+		storage = freeList;
+		freeList = freeList->next;
+	}
+	else {
+		if (slabUsed == SLAB_NODES) { //Current slab is full, start a new one
+			slabs.push_back(static_cast<Node*>(::operator new(sizeof(Node) * SLAB_NODES)));
+			STAT_ADD(allocations, 1);
+			STAT_ADD(allocatedBytes, sizeof(Node) * SLAB_NODES);
+			slabUsed = 0;
+		}
+		storage = slabs.back() + slabUsed;
+		++slabUsed;
+	}
+	return new (storage) Node(move(course));
+}
+
+/*
+ * Release() destroys the node's course and pushes its storage on the free list
+ *
+ * @param Node* node
+ */
+void NodePool::Release(Node* node) {
+	node->~Node();
+	FreeSlot* slot = new (static_cast<void*>(node)) FreeSlot;
+	slot->next = freeList;
+	freeList = slot;
+}
+
+/*
+ * ReleaseAll() frees every slab in one pass over the slab list.
+ * Nodes still in use must already have been destroyed by the owner
+ * (see BinarySearchTree::destroySubtree()).
+ */
+void NodePool::ReleaseAll() {
+	for (Node* slab : slabs) {
+		::operator delete(slab);
+	}
+	slabs.clear();
+	slabUsed = SLAB_NODES;
+	freeList = nullptr;
+}
+
+/*
+ * CourseHashIndex maps courseId -> course with open addressing (linear
+ * probing), so an exact-ID lookup costs one or two cache lines however deep
+ * the tree is. Each slot keeps the full hash next to the course pointer:
+ * probes skip other IDs without touching their courses, and growing the
+ * table does not rehash. Deletes shift later entries of the probe run back
+ * instead of leaving tombstones, so lookups never slow down over time.
+ * The index only points at courses; the owner keeps it in sync with its
+ * nodes and the pointers must stay valid while indexed.
+ */
+class CourseHashIndex {
+private:
+	struct Slot {
+		uint64_t hash = 0;
+		const Course* course = nullptr; //nullptr marks an empty slot
+	};
+
+	static const size_t MIN_SLOTS = 16;
+
+	vector<Slot> slots; //Power of two in size, at most 7/8 full
+	size_t count;
+
+	size_t mask() const { return slots.size() - 1; }
+	void grow(size_t courses);
+	size_t find(string_view courseId, uint64_t hash) const; //slot index, or slots.size()
 
+public:
+	CourseHashIndex() : count(0) {}
+
+	static uint64_t Hash(string_view courseId);
+	void Insert(const Course* course); //Adds course, or repoints its ID at it
+	void Erase(string_view courseId);
+	const Course* Find(string_view courseId) const;
+	void Reserve(size_t courses);
+	bool Verify(size_t courses, string& problem) const;
 };
 
-//default constructor
-BinarySearchTree::BinarySearchTree() {
-	//Set to empty
-	root = nullptr;
+/*
+ * Hash() mixes courseId eight bytes at a time (a course ID usually takes
+ * one or two words) and finishes with the murmur3 avalanche
+ *
+ * @param string_view courseId
+ * @return uint64_t
+ */
+uint64_t CourseHashIndex::Hash(string_view courseId) {
+	const uint64_t MULTIPLIER = 0x9E3779B97F4A7C15ULL;
+	uint64_t hash = courseId.size() * MULTIPLIER;
+	size_t i = 0;
+	for (; i + 8 <= courseId.size(); i += 8) {
+		uint64_t word;
+		memcpy(&word, courseId.data() + i, 8);
+		hash = (hash ^ word) * MULTIPLIER;
+		hash ^= hash >> 32;
+	}
+	uint64_t tail = 0;
+	memcpy(&tail, courseId.data() + i, courseId.size() - i);
+	hash ^= tail;
+
+	hash ^= hash >> 33;
+	hash *= 0xFF51AFD7ED558CCDULL;
+	hash ^= hash >> 33;
+	hash *= 0xC4CEB9FE1A85EC53ULL;
+	hash ^= hash >> 33;
+	return hash;
 }
 
-BinarySearchTree::~BinarySearchTree() {
+/*
+ * find() returns the slot holding courseId, or slots.size() if absent
+ *
+ * @param string_view courseId, uint64_t hash (of courseId)
+ * @return size_t
+ */
+size_t CourseHashIndex::find(string_view courseId, uint64_t hash) const {
+	if (slots.empty()) {
+		return 0;
+	}
+	uint64_t probes = 0;
+	size_t i = hash & mask();
+	while (slots[i].course != nullptr) {
+		++probes;
+		if (slots[i].hash == hash && slots[i].course->courseId == courseId) {
+			STAT_ADD(searchComparisons, probes);
+			return i;
+		}
+		i = (i + 1) & mask();
+	}
+	STAT_ADD(searchComparisons, probes);
+	return slots.size();
+}
+
+/*
+ * grow() moves every entry into a table big enough for courses
+ *
+ * @param size_t courses
+ */
+void CourseHashIndex::grow(size_t courses) {
+	size_t size = MIN_SLOTS;
+	while (size / 8 * 7 < courses) {
+		size *= 2;
+	}
+	if (size <= slots.size()) {
+		return;
+	}
 
+	vector<Slot> old(size);
+	old.swap(slots);
+	for (const Slot& slot : old) {
+		if (slot.course != nullptr) {
+			size_t i = slot.hash & mask();
+			while (slots[i].course != nullptr) {
+				i = (i + 1) & mask();
+			}
+			slots[i] = slot;
+		}
+	}
+	STAT_ADD(allocations, 1);
+	STAT_ADD(allocatedBytes, size * sizeof(Slot));
 }
 
 /*
- * InsertCourse() function is called from Parser::Parser() to take a
- * Node constructed from an input file read
+ * Reserve() makes room for courses entries, e.g. before a bulk load
  *
- * @param Course course (node structure)
+ * @param size_t courses
+ */
+void CourseHashIndex::Reserve(size_t courses) {
+	grow(courses);
+}
+
+/*
+ * Insert() indexes course under its courseId. An ID that is already
+ * indexed is pointed at course instead.
+ *
+ * @param const Course* course
  */
-void BinarySearchTree::InsertCourse(Course course) {
+void CourseHashIndex::Insert(const Course* course) {
+	grow(count + 1);
+	uint64_t hash = Hash(course->courseId);
+	size_t i = hash & mask();
+	while (slots[i].course != nullptr) {
+		if (slots[i].hash == hash && slots[i].course->courseId == course->courseId) {
+			slots[i].course = course;
+			return;
+		}
+		i = (i + 1) & mask();
+	}
+	slots[i].hash = hash;
+	slots[i].course = course;
+	++count;
+}
 
-	if (root == nullptr) { //if tree is empty
-		root = new Node(course); //starts tree
+/*
+ * Erase() removes courseId from the index, then walks the rest of the
+ * probe run and moves back every entry whose home slot is at or before
+ * the hole, so no lookup ever has to step over a deleted slot.
+ *
+ * @param string_view courseId
+ */
+void CourseHashIndex::Erase(string_view courseId) {
+	size_t hole = find(courseId, Hash(courseId));
+	if (hole >= slots.size()) {
+		return;
 	}
-	else { //tree not empty
-		this->addNode(root, course);
+	size_t i = hole;
+	while (true) {
+		i = (i + 1) & mask();
+		if (slots[i].course == nullptr) {
+			break;
+		}
+		size_t home = slots[i].hash & mask();
+		//Entry stays if its home lies cyclically in (hole, i]
+		bool stays = (hole < i) ? (home > hole && home <= i) : (home > hole || home <= i);
+		if (!stays) {
+			slots[hole] = slots[i];
+			hole = i;
+		}
 	}
+	slots[hole] = Slot();
+	--count;
 }
 
 /*
- * Recursive addNode() function that will build the BST
- * using nodes and the courseId as the ordering factor
+ * Find() returns the course with courseId, or nullptr
  *
- * @param Node node, Course course
+ * @param string_view courseId
+ * @return const Course*
  */
-void BinarySearchTree::addNode(Node* node, Course course) {
+const Course* CourseHashIndex::Find(string_view courseId) const {
+	size_t i = find(courseId, Hash(courseId));
+	return i < slots.size() ? slots[i].course : nullptr;
+}
 
-	if (node->course.courseId.compare(course.courseId) > 0) { //course ID is less than current Node
-		if (node->left == nullptr) { //Left leaf empty
-			node->left = new Node(course); //Assign to empty left
+/*
+ * Verify() checks the table against the invariants lookups rely on: it
+ * holds courses entries and is at most 7/8 full, each slot keeps its
+ * course's hash, and no empty slot lies between an entry and its home
+ * slot (what the backward shift in Erase() preserves).
+ *
+ * @param size_t courses (expected entries), string& problem
+ * @return bool false if an invariant is broken
+ */
+bool CourseHashIndex::Verify(size_t courses, string& problem) const {
+	size_t used = 0;
+	for (size_t i = 0; i < slots.size(); ++i) {
+		const Slot& slot = slots[i];
+		if (slot.course == nullptr) {
+			continue;
 		}
-		else { //Left leaf not empty
-			this->addNode(node->left, course); //Recurse down the left leaf
+		++used;
+		if (slot.hash != Hash(slot.course->courseId)) {
+			problem = "index slot of " + slot.course->courseId + " keeps a stale hash";
+			return false;
+		}
+		for (size_t j = slot.hash & mask(); j != i; j = (j + 1) & mask()) {
+			if (slots[j].course == nullptr) {
+				problem = "index entry " + slot.course->courseId + " is cut off from its home slot";
+				return false;
+			}
 		}
 	}
-	else { //Course ID is greater than current Node
-		if (node->right == nullptr) { //Right leaf empty
-			node->right = new Node(course); //Assign to empty right
+	if (used != count || count != courses || count > slots.size() / 8 * 7) {
+		problem = "index holds " + to_string(used) + " entries, counts " + to_string(count)
+			+ " for " + to_string(courses) + " courses in " + to_string(slots.size()) + " slots";
+		return false;
+	}
+	return true;
+}
+
+/*
+ * FrozenCatalog is a read-only copy of the tree laid out for fast batched
+ * lookups. The packed course keys are stored in one contiguous array in
+ * Eytzinger (BFS) order: the root is at index 1 and the children of index k
+ * are at 2k and 2k + 1. A lookup walks down the array instead of chasing
+ * node pointers. Single lookups are left to the hash index.
+ */
+class FrozenCatalog {
+private:
+	vector<CourseKey> keys;        //Packed courseIds in Eytzinger order, keys[0] unused
+	vector<const Course*> courses; //course for each key slot
+
+	size_t fill(const vector<const Course*>& sorted, size_t next, size_t k);
+
+public:
+	void Build(const vector<const Course*>& sorted);
+	void SearchMany(const string_view* courseIds, size_t count, const Course** results) const;
+	void Clear();
+};
+
+const size_t SEARCH_GROUP = 16; //Lookups SearchMany() walks at the same time
+
+/*
+ * Build() lays out the sorted courses in Eytzinger order
+ *
+ * @param vector<const Course*>& sorted (by courseId)
+ */
+void FrozenCatalog::Build(const vector<const Course*>& sorted) {
+	keys.resize(sorted.size() + 1);
+	courses.resize(sorted.size() + 1);
+	fill(sorted, 0, 1);
+}
+
+/*
+ * fill() places sorted courses into the subtree rooted at slot k with an
+ * in-order walk of the implicit tree, so the slots receive courses in order
+ *
+ * @param sorted, size_t next (next sorted course to place), size_t k (slot)
+ * @return size_t next course still to place
+ */
+size_t FrozenCatalog::fill(const vector<const Course*>& sorted, size_t next, size_t k) {
+	if (k < keys.size()) {
+		next = fill(sorted, next, 2 * k); //left subtree
+		keys[k] = CourseKey(sorted[next]->courseId);
+		courses[k] = sorted[next];
+		++next;
+		next = fill(sorted, next, 2 * k + 1); //right subtree
+	}
+	return next;
+}
+
+/*
+ * SearchMany() runs up to SEARCH_GROUP lookups in lockstep. Each step of
+ * a lookup moves to child 2k (smaller) or 2k + 1 (larger or equal) with no
+ * early exit; the last slot where the key was not smaller is the match
+ * candidate. Each round moves every lookup down one level and prefetches
+ * its next slot, so by the time a lookup is advanced again its slot has
+ * arrived and the cache misses of the whole group overlap.
+ *
+ * @param courseIds, size_t count (<= SEARCH_GROUP), results (count entries)
+ */
+void FrozenCatalog::SearchMany(const string_view* courseIds, size_t count, const Course** results) const {
+	size_t size = keys.size();
+	CourseKey searchKeys[SEARCH_GROUP];
+	size_t slots[SEARCH_GROUP];
+
+	for (size_t j = 0; j < count; ++j) {
+		searchKeys[j] = CourseKey(courseIds[j]);
+		slots[j] = 1;
+	}
+
+	bool walking = size > 1;
+	while (walking) {
+		walking = false;
+		for (size_t j = 0; j < count; ++j) {
+			size_t k = slots[j];
+			if (k >= size) { //This lookup already left the array
+				continue;
+			}
+			int comparison = CompareKeys(keys[k], searchKeys[j]);
+			if (comparison == 0) { //Keys tie, long IDs may still differ
+				comparison = CompareCourseIds(keys[k], courses[k]->courseId, searchKeys[j], courseIds[j]);
+			}
+			k = 2 * k + (comparison < 0 ? 1 : 0);
+			if (k < size) {
+				PREFETCH(&keys[k]);
+				walking = true;
+			}
+			slots[j] = k;
 		}
-		else { //Right leaf not empty
-			this->addNode(node->right, course); //Recurse down right leaf
+	}
+
+	//Undo the trailing right turns and the last left turn to find the candidate
+	for (size_t j = 0; j < count; ++j) {
+		size_t k = slots[j];
+		while (k & 1) {
+			k >>= 1;
+		}
+		k >>= 1;
+		results[j] = nullptr;
+		if (k != 0 && CompareCourseIds(keys[k], courses[k]->courseId, searchKeys[j], courseIds[j]) == 0) {
+			results[j] = courses[k];
 		}
 	}
 }
 
 /*
- * InOrder() function designed to recursively travel down a tree
- * Called once from main print option
- * calls inOrder() function, passing the current root as node
+ * Clear() drops the frozen copy
+ */
+void FrozenCatalog::Clear() {
+	keys.clear();
+	courses.clear();
+}
+
+
+/*
+ *  PrerequisiteGraph
+ *  Graph of prerequisite edges between courses, kept in sync by every catalog,
+ *  which must call Add() whenever a course enters the catalog and Remove()
+ *  when it leaves. Each course ID (including prerequisites that are not in
+ *  the catalog) gets an integer handle, and edges are stored both ways as
+ *  handle lists: prerequisites of a course, and its dependents.
+ *  e.g. [CSCI101] | dependents {CSCI200, CSCI301}
+ *  The dependents serve the delete dependency check. The transitive
+ *  prerequisites of a course are memoized as a bitset over handles, and a
+ *  change to a course only invalidates the cached sets of that course and
+ *  the courses that (transitively) depend on it.
+ *  The graph also keeps every handle at a position in a topological order
+ *  (prerequisites first), updated edge by edge with the Pearce-Kelly
+ *  algorithm, so FindCycle() only searches the part of the order between
+ *  the two ends of a new edge instead of the whole graph.
+ *  Queries update the caches, so in ConcurrentCourseTree they follow the
+ *  writer rules.
+ */
+class PrerequisiteGraph {
+private:
+	struct GraphNode {
+		string courseId;
+		vector<int> preReqs;     //handles of its prerequisites
+		vector<int> dependents;  //handles of courses listing it as a prerequisite
+		vector<uint64_t> closure; //bitset of its transitive prerequisites
+		bool inCatalog = false;  //course has been added (not only named as a prerequisite)
+		bool closureCurrent = false; //Invariant: a current closure has current prerequisite closures
+		bool visiting = false;   //on the closure() walk stack
+		int64_t order = 0;       //position in the topological order, prerequisites lower
+		bool marked = false;     //reached by the current order search
+		int from = -1;           //handle the order search came from, for the cycle path
+	};
+
+	unordered_map<string, int> handles; //course ID -> handle
+	vector<GraphNode> nodes;             //handle -> node
+	vector<int> freeHandles;             //handles of IDs no longer in the graph
+	vector<int> topologicalOrder;        //Cached TopologicalOrder() result
+	bool orderCurrent;
+	bool orderAcyclic;
+	int64_t nextOrder;                   //order given to the next new handle
+
+	int handleFor(const string& courseId);
+	int find(string_view courseId) const;
+	void release(int handle);
+	void unlink(vector<int>& handles, int handle);
+	void invalidate(int handle);
+	const vector<uint64_t>& closure(int handle);
+	bool searchDependents(int start, int target, vector<int>& reached);
+	void searchPreReqs(int start, int64_t lowest, vector<int>& reached);
+	void reorder(int course, int preReq);
+	void clearMarks(const vector<int>& reached);
+
+public:
+	PrerequisiteGraph();
+
+	bool IsPrerequisite(const string& courseId) const; //Enhancement for dependency check
+	void Add(const Course& course); //Adds course and the edges to its prerequisites
+	void Remove(const Course& course); //Removes course's edges (and the course once nothing depends on it)
+	void Reserve(size_t courses); //Room for a bulk load of courses
+	bool AddSorted(const vector<Course>& courses, const vector<int64_t>& preReqIndex); //Fills an empty graph from a snapshot's edges
+	bool FindCycle(const Course& course, vector<string>& cycle); //Would adding course close a prerequisite cycle?
+
+	int Handle(string_view courseId) const { return find(courseId); } //-1 if not in the graph
+	const string& CourseId(int handle) const { return nodes[handle].courseId; }
+	bool TransitivePrerequisites(string_view courseId, vector<string>& result);
+	bool DependsOn(string_view courseId, string_view preReqId);
+	void DependentClosure(const vector<string>& courseIds, vector<string>& closure); //courseIds and all their dependents
+	void SortDependentsFirst(vector<string>& courseIds) const; //By the topological order, dependents first
+	bool TopologicalOrder(vector<string>& order);
+	bool Verify(string& problem) const; //Checks the graph's invariants, for the test program
+};
+
+PrerequisiteGraph::PrerequisiteGraph() {
+	orderCurrent = true;
+	orderAcyclic = true;
+	nextOrder = 0;
+}
+
+/*
+ * find() returns the handle of courseId, or -1 if it is not in the graph
+ *
+ * @param string_view courseId
+ * @return int
+ */
+int PrerequisiteGraph::find(string_view courseId) const {
+	auto entry = handles.find(string(courseId));
+	return entry == handles.end() ? -1 : entry->second;
+}
+
+/*
+ * handleFor() returns the handle of courseId, giving it one (reusing a
+ * released handle first) if it has none yet
+ *
+ * @param string courseId
+ * @return int
+ */
+int PrerequisiteGraph::handleFor(const string& courseId) {
+	int next = freeHandles.empty() ? static_cast<int>(nodes.size()) : freeHandles.back();
+	auto entry = handles.try_emplace(courseId, next);
+	if (!entry.second) { //Already has a handle
+		return entry.first->second;
+	}
+	if (next == static_cast<int>(nodes.size())) {
+		nodes.emplace_back();
+	}
+	else {
+		freeHandles.pop_back();
+	}
+	nodes[next].courseId = courseId;
+	nodes[next].order = nextOrder++; //New IDs have no edges yet, so any free position works
+	return next;
+}
+
+/*
+ * Reserve() makes room for courses more handles, so a bulk load does not
+ * rehash the ID map or move the nodes as it grows
+ *
+ * @param size_t courses
+ */
+void PrerequisiteGraph::Reserve(size_t courses) {
+	handles.reserve(handles.size() + courses);
+	nodes.reserve(nodes.size() + courses);
+}
+
+/*
+ * AddSorted() fills an empty graph with a snapshot's courses in one pass:
+ * courses[i] gets handle i, and preReqIndex[2i] and [2i + 1] are the
+ * indexes of its prerequisites in courses (-1 if none, or if the
+ * prerequisite is not in the catalog). No ID is looked up for an edge
+ * inside the catalog, and the topological order is computed once with
+ * Kahn's algorithm instead of being repaired edge by edge. Prerequisites
+ * outside the catalog are placed before every course.
+ *
+ * @param vector<Course>& courses, vector<int64_t>& preReqIndex
+ * @return bool false (graph untouched) if the graph is not empty or the edges close a cycle
+ */
+bool PrerequisiteGraph::AddSorted(const vector<Course>& courses, const vector<int64_t>& preReqIndex) {
+	size_t count = courses.size();
+	if (!handles.empty() || preReqIndex.size() != 2 * count) {
+		return false;
+	}
+	vector<GraphNode> built(count);
+	vector<int> remaining(count, 0); //Prerequisites not yet placed
+	for (size_t i = 0; i < count; ++i) {
+		built[i].courseId = courses[i].courseId;
+		built[i].inCatalog = true;
+		for (size_t k = 2 * i; k < 2 * i + 2; ++k) {
+			if (preReqIndex[k] >= 0) {
+				built[i].preReqs.push_back(static_cast<int>(preReqIndex[k]));
+				built[preReqIndex[k]].dependents.push_back(static_cast<int>(i));
+				++remaining[i];
+			}
+		}
+	}
+
+	vector<int> ready;
+	for (size_t i = 0; i < count; ++i) {
+		if (remaining[i] == 0) {
+			ready.push_back(static_cast<int>(i));
+		}
+	}
+	int64_t placed = 0;
+	while (!ready.empty()) {
+		int handle = ready.back();
+		ready.pop_back();
+		built[handle].order = placed++;
+		for (int dependent : built[handle].dependents) {
+			if (--remaining[dependent] == 0) {
+				ready.push_back(dependent);
+			}
+		}
+	}
+	if (placed != static_cast<int64_t>(count)) { //Some courses wait on each other
+		return false;
+	}
+
+	nodes.swap(built);
+	handles.reserve(count);
+	for (size_t i = 0; i < count; ++i) {
+		handles.emplace(nodes[i].courseId, static_cast<int>(i));
+	}
+	nextOrder = placed;
+	orderCurrent = false;
+
+	int64_t outside = 0;
+	for (size_t i = 0; i < count; ++i) {
+		const string* links[] = { &courses[i].preReq1, &courses[i].preReq2 };
+		for (size_t k = 0; k < 2; ++k) {
+			if (preReqIndex[2 * i + k] >= 0 || links[k]->empty()) {
+				continue;
+			}
+			bool named = find(*links[k]) >= 0;
+			int preReqHandle = handleFor(*links[k]);
+			if (!named) {
+				nodes[preReqHandle].order = -1 - outside++; //No prerequisites of its own, so before everything works
+			}
+			nodes[i].preReqs.push_back(preReqHandle);
+			nodes[preReqHandle].dependents.push_back(static_cast<int>(i));
+		}
+	}
+	return true;
+}
+
+/*
+ * release() gives a handle back once its course has left the catalog and
+ * nothing lists it as a prerequisite. No current closure can contain it,
+ * since every course that reached it was a dependent.
+ *
+ * @param int handle
+ */
+void PrerequisiteGraph::release(int handle) {
+	GraphNode& node = nodes[handle];
+	if (node.inCatalog || !node.dependents.empty() || !node.preReqs.empty()) {
+		return;
+	}
+	if (find(node.courseId) != handle) { //Already released (listed twice as a prerequisite)
+		return;
+	}
+	handles.erase(node.courseId);
+	node = GraphNode();
+	freeHandles.push_back(handle);
+}
+
+//Removes one occurrence of handle from list (swap with last and pop, order doesn't matter)
+void PrerequisiteGraph::unlink(vector<int>& list, int handle) {
+	for (size_t i = 0; i < list.size(); ++i) {
+		if (list[i] == handle) {
+			list[i] = list.back();
+			list.pop_back();
+			return;
+		}
+	}
+}
+
+/*
+ * invalidate() marks the closure of handle and of every course depending on
+ * it stale. The walk stops at closures that are already stale, since by the
+ * invariant nothing above them can be current, so repeated changes stay cheap.
+ *
+ * @param int handle
+ */
+void PrerequisiteGraph::invalidate(int handle) {
+	orderCurrent = false;
+	if (!nodes[handle].closureCurrent) { //Nothing cached above it either
+		return;
+	}
+	vector<int> pending;
+	pending.push_back(handle);
+	while (!pending.empty()) {
+		GraphNode& node = nodes[pending.back()];
+		pending.pop_back();
+		if (!node.closureCurrent) {
+			continue;
+		}
+		node.closureCurrent = false;
+		pending.insert(pending.end(), node.dependents.begin(), node.dependents.end());
+	}
+}
+
+/*
+ *  IsPrerequisite()
+ *  This function serves as a dependency check. We don't want to delete lower level
+ *  courses if they are required for higher level courses (a prerequisite to a higher course)
+ *  so we must check to ensure that the course TO BE deleted is not a prerequisite for
+ *  an existing course.
+ *  **NOTE: This is part of the deleteCourse function, called from menu option 5.
+ *          It looks up the course's dependents in the graph instead of
+ *          checking every node, so it no longer costs O(n) per delete.
+ *  @param string courseId
+ *  @return bool
+ */
+bool PrerequisiteGraph::IsPrerequisite(const string& courseId) const {
+	int handle = find(courseId);
+	STAT_ADD(dependencyChecks, 1);
+
+	//A course is a dependency if at least one course lists it as a prerequisite
+	return handle >= 0 && !nodes[handle].dependents.empty();
+}
+
+/*
+ *  Add()
+ *  Adds course to the graph with an edge to each of its prerequisites.
+ *  Called whenever a course enters the catalog.
+ *  @param Course& course
+ */
+void PrerequisiteGraph::Add(const Course& course) {
+	int handle = handleFor(course.courseId);
+	nodes[handle].inCatalog = true;
+	const string* links[] = { &course.preReq1, &course.preReq2 };
+	for (const string* preReq : links) {
+		if (!preReq->empty()) {
+			int preReqHandle = handleFor(*preReq);
+			if (nodes[preReqHandle].order > nodes[handle].order) { //Edge points backwards in the order
+				reorder(handle, preReqHandle);
+			}
+			nodes[handle].preReqs.push_back(preReqHandle);
+			nodes[preReqHandle].dependents.push_back(handle);
+		}
+	}
+	invalidate(handle);
+}
+
+/*
+ *  Remove()
+ *  Reverses Add() when a course leaves the catalog (or is replaced).
+ *  Costs O(k) in the number of dependents of each prerequisite, and gives
+ *  back the handles of IDs that are no longer linked to anything.
+ *  @param Course& course
+ */
+void PrerequisiteGraph::Remove(const Course& course) {
+	int handle = find(course.courseId);
+	if (handle < 0) {
+		return;
+	}
+	invalidate(handle);
+	for (int preReqHandle : nodes[handle].preReqs) {
+		unlink(nodes[preReqHandle].dependents, handle);
+	}
+	vector<int> formerPreReqs;
+	formerPreReqs.swap(nodes[handle].preReqs);
+	nodes[handle].inCatalog = false;
+
+	for (int preReqHandle : formerPreReqs) {
+		release(preReqHandle);
+	}
+	release(handle);
+}
+
+/*
+ * searchDependents() walks forward from start along dependent edges,
+ * visiting only handles placed before target in the order (anything after
+ * it cannot lead back to it). Every handle reached is marked, remembers
+ * where it was reached from and is added to reached.
+ *
+ * @param int start, int target, vector<int>& reached
+ * @return bool true if target was reached
+ */
+bool PrerequisiteGraph::searchDependents(int start, int target, vector<int>& reached) {
+	int64_t highest = nodes[target].order;
+	vector<int> pending;
+	pending.push_back(start);
+	nodes[start].marked = true;
+	nodes[start].from = -1;
+	reached.push_back(start);
+
+	while (!pending.empty()) {
+		int handle = pending.back();
+		pending.pop_back();
+		for (int dependent : nodes[handle].dependents) {
+			GraphNode& next = nodes[dependent];
+			if (next.marked || next.order > highest) {
+				continue;
+			}
+			next.marked = true;
+			next.from = handle;
+			reached.push_back(dependent);
+			if (dependent == target) {
+				return true;
+			}
+			pending.push_back(dependent);
+		}
+	}
+	return false;
+}
+
+/*
+ * searchPreReqs() walks backward from start along prerequisite edges,
+ * visiting only handles placed after position lowest, marking and
+ * collecting them like searchDependents()
+ *
+ * @param int start, int64_t lowest, vector<int>& reached
+ */
+void PrerequisiteGraph::searchPreReqs(int start, int64_t lowest, vector<int>& reached) {
+	vector<int> pending;
+	pending.push_back(start);
+	nodes[start].marked = true;
+	reached.push_back(start);
+
+	while (!pending.empty()) {
+		int handle = pending.back();
+		pending.pop_back();
+		for (int preReq : nodes[handle].preReqs) {
+			GraphNode& next = nodes[preReq];
+			if (next.marked || next.order < lowest) {
+				continue;
+			}
+			next.marked = true;
+			reached.push_back(preReq);
+			pending.push_back(preReq);
+		}
+	}
+}
+
+/*
+ * clearMarks() unmarks the handles one search reached (and counts them)
+ *
+ * @param vector<int>& reached
+ */
+void PrerequisiteGraph::clearMarks(const vector<int>& reached) {
+	STAT_ADD(cycleSearchNodes, reached.size());
+	for (int handle : reached) {
+		nodes[handle].marked = false;
+	}
+}
+
+/*
+ * reorder() makes room for a new edge preReq -> course where preReq is
+ * placed after course (Pearce-Kelly). The courses depending on course and
+ * the prerequisites of preReq that lie between the two are found, then the
+ * positions they held are handed out again, prerequisites of preReq first.
+ * Only that region of the order moves.
+ *
+ * @param int course, int preReq (must not close a cycle, see FindCycle())
+ */
+void PrerequisiteGraph::reorder(int course, int preReq) {
+	vector<int> forward;
+	vector<int> backward;
+	if (searchDependents(course, preReq, forward)) { //Cycle (FindCycle() was skipped), no valid order exists
+		clearMarks(forward);
+		return;
+	}
+	clearMarks(forward);
+	searchPreReqs(preReq, nodes[course].order, backward);
+	clearMarks(backward);
+
+	auto byOrder = [this](int a, int b) {
+		return nodes[a].order < nodes[b].order;
+	};
+	sort(forward.begin(), forward.end(), byOrder);
+	sort(backward.begin(), backward.end(), byOrder);
+
+	vector<int64_t> positions;
+	positions.reserve(forward.size() + backward.size());
+	for (int handle : backward) {
+		positions.push_back(nodes[handle].order);
+	}
+	for (int handle : forward) {
+		positions.push_back(nodes[handle].order);
+	}
+	sort(positions.begin(), positions.end());
+
+	size_t next = 0;
+	for (int handle : backward) {
+		nodes[handle].order = positions[next++];
+	}
+	for (int handle : forward) {
+		nodes[handle].order = positions[next++];
+	}
+}
+
+/*
+ * FindCycle() checks, before course is added (or replaces the course with
+ * its ID), whether one of its prerequisites already depends on it.
+ * If so the prerequisite chain is returned in cycle, starting and ending
+ * with the course, e.g. CSCI300 -> CSCI350 -> CSCI300.
+ * A prerequisite placed before the course in the order cannot depend on it,
+ * so most checks cost O(1); otherwise only the region of the order between
+ * the two is searched.
+ *
+ * @param Course& course, vector<string>& cycle
+ * @return bool true if adding course would close a cycle
+ */
+bool PrerequisiteGraph::FindCycle(const Course& course, vector<string>& cycle) {
+	const string* links[] = { &course.preReq1, &course.preReq2 };
+	for (const string* preReq : links) {
+		if (preReq->empty()) {
+			continue;
+		}
+		if (*preReq == course.courseId) { //Course lists itself
+			cycle.assign(2, course.courseId);
+			return true;
+		}
+		int handle = find(course.courseId);
+		int preReqHandle = find(*preReq);
+		if (handle < 0 || preReqHandle < 0 || nodes[preReqHandle].order < nodes[handle].order) {
+			continue; //Nothing depends on a new ID, and an earlier prerequisite cannot
+		}
+
+		vector<int> reached;
+		bool found = searchDependents(handle, preReqHandle, reached);
+		if (found) {
+			//Walk back from the prerequisite: each handle requires the one it was reached from
+			cycle.push_back(course.courseId);
+			for (int at = preReqHandle; at != -1; at = nodes[at].from) {
+				cycle.push_back(nodes[at].courseId);
+			}
+		}
+		clearMarks(reached);
+		if (found) {
+			return true;
+		}
+	}
+	return false;
+}
+
+/*
+ * ReportCycle() prints why course was refused, e.g.
+ * Error: Can not add CSCI300. It would create a prerequisite cycle: CSCI300 -> CSCI350 -> CSCI300
+ *
+ * @param string courseId, vector<string> cycle (from FindCycle())
+ */
+void ReportCycle(const string& courseId, const vector<string>& cycle) {
+	cout << "Error: Can not add " << courseId << ". It would create a prerequisite cycle: ";
+	for (size_t i = 0; i < cycle.size(); ++i) {
+		cout << (i == 0 ? "" : " -> ") << cycle[i];
+	}
+	cout << endl;
+}
+
+/*
+ * LastAccepted() takes the run of courses sharing the ID of courses[position]
+ * in a batch sorted by courseId, and treats it the way repeated InsertCourse()
+ * calls would: every occurrence that would close a prerequisite cycle is
+ * reported, and the last one that would not is the one to keep. Which
+ * earlier occurrence was stored does not matter, since a cycle through the
+ * course runs through its dependents, not its own prerequisites, so each
+ * occurrence is checked against the graph as it is.
+ *
+ * @param courses (sorted), size_t& position (moved to the last of the run), graph
+ * @return size_t index of the occurrence to keep, courses.size() if all were refused
+ */
+size_t LastAccepted(const vector<Course>& courses, size_t& position, PrerequisiteGraph& graph) {
+	size_t kept = courses.size();
+	vector<string> cycle;
+	for (size_t c = position; c < courses.size() && courses[c].courseId == courses[position].courseId; ++c) {
+		if (graph.FindCycle(courses[c], cycle)) {
+			ReportCycle(courses[c].courseId, cycle);
+			cycle.clear();
+		}
+		else {
+			kept = c;
+		}
+		position = c;
+	}
+	return kept;
+}
+
+/*
+ * closure() returns the transitive prerequisites of handle as a bitset,
+ * computing any stale closures below it first with an explicit stack
+ * (prerequisite chains can be longer than the call stack allows).
+ * On a prerequisite cycle the walk does not revisit the course it started
+ * from, so the courses of the cycle get the sets found so far.
+ *
+ * @param int handle
+ * @return const vector<uint64_t>& (bit h set if handle h is a prerequisite)
+ */
+const vector<uint64_t>& PrerequisiteGraph::closure(int handle) {
+	if (nodes[handle].closureCurrent) {
+		return nodes[handle].closure;
+	}
+
+	vector<pair<int, size_t>> stack; //handle, next prerequisite to visit
+	stack.emplace_back(handle, 0);
+	nodes[handle].visiting = true;
+
+	while (!stack.empty()) {
+		GraphNode& node = nodes[stack.back().first];
+		size_t& next = stack.back().second;
+		if (next < node.preReqs.size()) {
+			int preReq = node.preReqs[next++];
+			if (!nodes[preReq].closureCurrent && !nodes[preReq].visiting) {
+				stack.emplace_back(preReq, 0);
+				nodes[preReq].visiting = true;
+			}
+			continue;
+		}
+
+		//Every prerequisite is done, closure = prerequisites + their closures.
+		//The bitset only reaches the highest handle set, not the whole graph.
+		size_t words = 0;
+		for (int preReq : node.preReqs) {
+			words = max(words, static_cast<size_t>(preReq) / 64 + 1);
+			if (nodes[preReq].closureCurrent) {
+				words = max(words, nodes[preReq].closure.size());
+			}
+		}
+		node.closure.assign(words, 0);
+		for (int preReq : node.preReqs) {
+			node.closure[preReq / 64] |= uint64_t(1) << (preReq % 64);
+			if (nodes[preReq].closureCurrent) {
+				const vector<uint64_t>& below = nodes[preReq].closure;
+				for (size_t w = 0; w < below.size(); ++w) {
+					node.closure[w] |= below[w];
+				}
+			}
+		}
+		node.closureCurrent = true;
+		node.visiting = false;
+		stack.pop_back();
+	}
+	return nodes[handle].closure;
+}
+
+/*
+ * TransitivePrerequisites() lists every course that must be taken before
+ * courseId, directly or through other prerequisites, sorted by course ID
+ *
+ * @param string_view courseId, vector<string>& result
+ * @return bool false if courseId is not in the graph
+ */
+bool PrerequisiteGraph::TransitivePrerequisites(string_view courseId, vector<string>& result) {
+	int handle = find(courseId);
+	if (handle < 0) {
+		return false;
+	}
+	const vector<uint64_t>& bits = closure(handle);
+	for (size_t w = 0; w < bits.size(); ++w) {
+		for (uint64_t word = bits[w]; word != 0; word &= word - 1) {
+			int bit = 0;
+			while (((word >> bit) & 1) == 0) {
+				++bit;
+			}
+			result.push_back(nodes[w * 64 + bit].courseId);
+		}
+	}
+	sort(result.begin(), result.end());
+	return true;
+}
+
+/*
+ * DependsOn() tells if preReqId is a direct or transitive prerequisite
+ * of courseId, one bit test once the closure is cached
+ *
+ * @param string_view courseId, string_view preReqId
+ * @return bool
+ */
+bool PrerequisiteGraph::DependsOn(string_view courseId, string_view preReqId) {
+	int handle = find(courseId);
+	int preReqHandle = find(preReqId);
+	if (handle < 0 || preReqHandle < 0) {
+		return false;
+	}
+	const vector<uint64_t>& bits = closure(handle);
+	size_t word = static_cast<size_t>(preReqHandle) / 64;
+	return word < bits.size() && ((bits[word] >> (preReqHandle % 64)) & 1) != 0;
+}
+
+/*
+ * DependentClosure() lists the courses in courseIds that are in the
+ * catalog together with every course depending on them, directly or
+ * through other courses, each once. One walk over the dependent edges
+ * covers the whole set, so it costs O(k + e) for k courses and e edges
+ * reached. Dependents come before their prerequisites (by position in the
+ * order), which is also a safe order to delete them one at a time.
+ *
+ * @param vector<string>& courseIds, vector<string>& closure
+ */
+void PrerequisiteGraph::DependentClosure(const vector<string>& courseIds, vector<string>& closure) {
+	vector<int> reached;
+	for (const string& courseId : courseIds) {
+		int handle = find(courseId);
+		if (handle < 0 || !nodes[handle].inCatalog || nodes[handle].marked) {
+			continue;
+		}
+		nodes[handle].marked = true;
+		reached.push_back(handle);
+	}
+	//reached doubles as the work list, dependents are always in the catalog
+	for (size_t i = 0; i < reached.size(); ++i) {
+		for (int dependent : nodes[reached[i]].dependents) {
+			if (!nodes[dependent].marked) {
+				nodes[dependent].marked = true;
+				reached.push_back(dependent);
+			}
+		}
+	}
+
+	sort(reached.begin(), reached.end(), [this](int a, int b) { return nodes[a].order > nodes[b].order; });
+	for (int handle : reached) {
+		nodes[handle].marked = false;
+		closure.push_back(nodes[handle].courseId);
+	}
+}
+
+/*
+ * SortDependentsFirst() sorts courseIds so every course comes before its
+ * prerequisites, by the order the graph already maintains, in
+ * O(k log k) for k IDs. IDs not in the graph go last, in their given order.
+ *
+ * @param vector<string>& courseIds
+ */
+void PrerequisiteGraph::SortDependentsFirst(vector<string>& courseIds) const {
+	vector<pair<int64_t, size_t>> positions; //(order, index in courseIds)
+	positions.reserve(courseIds.size());
+	for (size_t i = 0; i < courseIds.size(); ++i) {
+		int handle = find(courseIds[i]);
+		positions.emplace_back(handle < 0 ? numeric_limits<int64_t>::min() : nodes[handle].order, i);
+	}
+	stable_sort(positions.begin(), positions.end(), [](const pair<int64_t, size_t>& a, const pair<int64_t, size_t>& b) {
+		return a.first > b.first;
+	});
+	vector<string> sorted;
+	sorted.reserve(courseIds.size());
+	for (const pair<int64_t, size_t>& position : positions) {
+		sorted.push_back(move(courseIds[position.second]));
+	}
+	courseIds.swap(sorted);
+}
+
+/*
+ * TopologicalOrder() lists every course in the catalog so that each one
+ * comes after all of its prerequisites (Kahn's algorithm). The order is
+ * cached until the next Add() or Remove().
+ * Prerequisites that are not in the catalog are left out.
+ *
+ * @param vector<string>& order
+ * @return bool false if a prerequisite cycle left some courses out
+ */
+bool PrerequisiteGraph::TopologicalOrder(vector<string>& order) {
+	if (!orderCurrent) {
+		vector<int> remaining(nodes.size(), 0); //Prerequisites not yet placed
+		vector<int> ready;
+		size_t live = 0;
+		for (size_t h = 0; h < nodes.size(); ++h) {
+			if (find(nodes[h].courseId) != static_cast<int>(h)) { //Released handle
+				continue;
+			}
+			++live;
+			remaining[h] = static_cast<int>(nodes[h].preReqs.size());
+			if (remaining[h] == 0) {
+				ready.push_back(static_cast<int>(h));
+			}
+		}
+
+		topologicalOrder.clear();
+		size_t placed = 0;
+		while (!ready.empty()) {
+			int handle = ready.back();
+			ready.pop_back();
+			++placed;
+			if (nodes[handle].inCatalog) {
+				topologicalOrder.push_back(handle);
+			}
+			for (int dependent : nodes[handle].dependents) {
+				if (--remaining[dependent] == 0) {
+					ready.push_back(dependent);
+				}
+			}
+		}
+		orderAcyclic = (placed == live);
+		orderCurrent = true;
+	}
+
+	for (int handle : topologicalOrder) {
+		order.push_back(nodes[handle].courseId);
+	}
+	return orderAcyclic;
+}
+
+/*
+ * Verify() checks the graph's invariants: every live handle is in the ID
+ * map under its own ID, each edge is listed from both ends, every
+ * prerequisite is placed before its dependents in the order (the
+ * Pearce-Kelly invariant FindCycle() relies on), and no two handles share
+ * a position. Nothing is printed; problem says what is wrong.
+ *
+ * @param string& problem
+ * @return bool false if an invariant is broken
+ */
+bool PrerequisiteGraph::Verify(string& problem) const {
+	unordered_map<int64_t, int> positions;
+	for (const auto& entry : handles) {
+		int handle = entry.second;
+		const GraphNode& node = nodes[handle];
+		if (node.courseId != entry.first) {
+			problem = "handle of " + entry.first + " holds " + node.courseId;
+			return false;
+		}
+		if (!positions.emplace(node.order, handle).second) {
+			problem = node.courseId + " shares its order with " + nodes[positions[node.order]].courseId;
+			return false;
+		}
+		if (!node.inCatalog && node.dependents.empty()) {
+			problem = node.courseId + " is linked to nothing but still has a handle";
+			return false;
+		}
+		for (int preReq : node.preReqs) {
+			const vector<int>& back = nodes[preReq].dependents;
+			if (std::find(back.begin(), back.end(), handle) == back.end()) {
+				problem = node.courseId + " -> " + nodes[preReq].courseId + " is missing its dependent link";
+				return false;
+			}
+			if (nodes[preReq].order >= node.order) {
+				problem = nodes[preReq].courseId + " is ordered after its dependent " + node.courseId;
+				return false;
+			}
+		}
+		for (int dependent : node.dependents) {
+			const vector<int>& back = nodes[dependent].preReqs;
+			if (std::find(back.begin(), back.end(), handle) == back.end()) {
+				problem = nodes[dependent].courseId + " is listed as a dependent of " + node.courseId + " without the edge";
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+
+/*
+ * OutputSink collects formatted output in one large reusable buffer and
+ * hands it to its target only when the buffer fills or Flush() is called,
+ * so printing a long course list costs a few large writes instead of one
+ * flush per line. FileSink writes to a file descriptor (1 for the console
+ * or a pipe), MemorySink appends to a string for export jobs.
+ */
+class OutputSink {
+private:
+	vector<char> buffer;
+	size_t used;
+
+protected:
+	virtual void emit(const char* data, size_t size) = 0; //Delivers bytes to the target
+
+public:
+	static const size_t DEFAULT_CAPACITY = 64 * 1024;
+
+	explicit OutputSink(size_t capacity = DEFAULT_CAPACITY) : buffer(capacity), used(0) {}
+	virtual ~OutputSink() {} //Derived sinks flush in their own destructor, while emit() still works
+	OutputSink(const OutputSink&) = delete;
+	OutputSink& operator=(const OutputSink&) = delete;
+
+	void Write(string_view text);
+	void Put(char character);
+	void Flush();
+};
+
+/*
+ * Write() appends text to the buffer, flushing first if it does not fit.
+ * Text as large as the whole buffer goes straight to the target.
+ *
+ * @param string_view text
+ */
+void OutputSink::Write(string_view text) {
+	if (text.size() > buffer.size() - used) {
+		Flush();
+		if (text.size() >= buffer.size()) {
+			emit(text.data(), text.size());
+			return;
+		}
+	}
+	memcpy(buffer.data() + used, text.data(), text.size());
+	used += text.size();
+}
+
+void OutputSink::Put(char character) {
+	if (used == buffer.size()) {
+		Flush();
+	}
+	buffer[used++] = character;
+}
+
+/*
+ * Flush() hands everything buffered to the target
+ */
+void OutputSink::Flush() {
+	if (used > 0) {
+		emit(buffer.data(), used);
+		used = 0;
+	}
+}
+
+class FileSink : public OutputSink {
+private:
+	int fileDescriptor;
+
+protected:
+	void emit(const char* data, size_t size) override;
+
+public:
+	explicit FileSink(int descriptor, size_t capacity = DEFAULT_CAPACITY)
+		: OutputSink(capacity), fileDescriptor(descriptor) {}
+	~FileSink() { Flush(); }
+};
+
+/*
+ * emit() writes all of data to the descriptor, retrying short writes
+ *
+ * @param data, size
+ */
+void FileSink::emit(const char* data, size_t size) {
+	while (size > 0) {
+#ifdef _WIN32
+		int written = _write(fileDescriptor, data, static_cast<unsigned>(size < INT_MAX ? size : INT_MAX));
+#else
+		ssize_t written = write(fileDescriptor, data, size);
+		if (written < 0 && errno == EINTR) {
+			continue;
+		}
+#endif
+		if (written <= 0) { //Descriptor closed or full, drop the rest
+			return;
+		}
+		data += written;
+		size -= static_cast<size_t>(written);
+	}
+}
+
+class MemorySink : public OutputSink {
+private:
+	string contents;
+
+protected:
+	void emit(const char* data, size_t size) override {
+		contents.append(data, size);
+	}
+
+public:
+	explicit MemorySink(size_t capacity = DEFAULT_CAPACITY) : OutputSink(capacity) {}
+	const string& Contents() { Flush(); return contents; }
+};
+
+
+const size_t CASCADE_REBUILD_FRACTION = 16; //A cascade removing over 1/16 of the catalog rebuilds it instead
+
+/*
+ * CourseCatalog is the interface main() and Parser use to store courses.
+ * BinarySearchTree (AVL tree of course nodes) is the default implementation,
+ * CourseBTree (wide B-tree over out-of-line records) can be chosen at startup
+ * with --btree, ConcurrentCourseTree (AVL tree with lock-free readers)
+ * with --concurrent, and PersistentCourseTree (versioned AVL tree with
+ * O(1) snapshots) with --persistent. Any of them can be wrapped in a
+ * LoggedCatalog with --log <file> so its changes survive a restart.
+ */
+class CourseCatalog {
+	friend class LoggedCatalog; //Forwards the primitives below to the catalog it wraps
+
+protected:
+	//Primitives of the shared load and cascade paths, called with lockWriters() held
+	virtual void mergeSorted(vector<Course>& courses) = 0; //courses sorted, IDs unique and already in the graph
+	virtual void eraseEach(const vector<string>& courseIds) = 0; //Stored courses, dependents first, one delete each
+	virtual void eraseSorted(const vector<string>& doomed) = 0; //Stored courses sorted by ID, one rebuild
+	virtual unique_lock<mutex> lockWriters() { return unique_lock<mutex>(); } //Catalogs with lock-free readers serialize writers
+
+	void bulkLoad(vector<Course>& courses); //BulkLoad() with lockWriters() already held
+
+public:
+	virtual ~CourseCatalog() {}
+	virtual void InOrder(OutputSink& sink) = 0; //Writes every course to sink, the caller flushes
+	virtual void InOrderPage(size_t first, size_t count, OutputSink& sink) const;
+	virtual bool InsertCourse(Course course) = 0; //false if refused (prerequisite cycle)
+	virtual void BulkLoad(vector<Course>& courses);
+	virtual void LoadSorted(vector<Course>& courses, const vector<int64_t>& preReqIndex); //A snapshot's courses and edges
+	virtual const Course* Search(string_view courseId) const = 0;
+	virtual void SearchMany(const vector<string_view>& courseIds, vector<const Course*>& results) const;
+	virtual size_t Size() const = 0;
+	virtual bool DeleteCourseWithDependencyCheck(const string& courseId) = 0;
+	virtual void DeleteCascade(const vector<string>& courseIds, vector<string>& removed); //courseIds and all their dependents
+	virtual void CollectCourses(vector<const Course*>& sorted) const = 0; //Every course in courseId order
+	virtual PrerequisiteGraph& Prerequisites() = 0; //Prerequisite edges, for the thread making changes only (not synchronized)
+	virtual void Shape(TreeShape& shape) const = 0; //Courses at each depth, for the stats report
+	virtual void Commit() {} //Makes the changes so far durable, only a logged catalog has work to do
+	virtual void LoadFile(const string& fileName); //Loads a course file or snapshot with Parser
+	virtual bool Verify(string& problem) const; //Checks the catalog's invariants, for the test program
+};
+
+/*
+ * InOrderPage() writes count courses starting at position first (0-based,
+ * in courseId order) to sink, e.g. one page of the course list. This default
+ * collects every course first; BinarySearchTree jumps straight to first.
+ *
+ * @param size_t first, size_t count, OutputSink sink
+ */
+void CourseCatalog::InOrderPage(size_t first, size_t count, OutputSink& sink) const {
+	vector<const Course*> sorted;
+	CollectCourses(sorted);
+	for (size_t i = first; i < sorted.size() && i - first < count; ++i) {
+		sink.Write(sorted[i]->courseId);
+		sink.Write(", ");
+		sink.Write(sorted[i]->courseName);
+		sink.Put('\n');
+	}
+}
+
+/*
+ * BulkLoad() inserts a whole batch of courses (e.g. every row of a file)
+ * and has the catalog merge them in one pass (mergeSorted()), instead of
+ * O(m log n) work through repeated InsertCourse() calls.
+ * The batch is sorted by courseId unless it already is (registrar exports
+ * usually are). As with InsertCourse(), a repeated course ID replaces the
+ * earlier course and a course that would close a prerequisite cycle is
+ * reported and left out, so of a repeated ID the last occurrence that is
+ * not refused wins (see LastAccepted()). Courses are moved out of the
+ * batch, leaving the batch entries empty.
+ *
+ * @param vector<Course>& courses (sorted in place)
+ */
+void CourseCatalog::BulkLoad(vector<Course>& courses) {
+	unique_lock<mutex> lock = lockWriters();
+	bulkLoad(courses);
+}
+
+void CourseCatalog::bulkLoad(vector<Course>& courses) {
+	PrerequisiteGraph& graph = Prerequisites();
+	graph.Reserve(courses.size());
+
+	auto byCourseId = [](const Course& a, const Course& b) {
+		return a.courseId < b.courseId;
+	};
+	if (!is_sorted(courses.begin(), courses.end(), byCourseId)) {
+		stable_sort(courses.begin(), courses.end(), byCourseId); //stable keeps file order among repeated IDs
+	}
+
+	vector<Course> accepted;
+	accepted.reserve(courses.size());
+	for (size_t c = 0; c < courses.size(); ++c) {
+		//A run of equal IDs goes in like repeated InsertCourse() calls, c ends on its last
+		size_t kept = LastAccepted(courses, c, graph);
+		if (kept == courses.size()) { //All refused, a stored course stays as it is
+			continue;
+		}
+		graph.Remove(courses[kept]); //Drops the edges of a stored course with this ID, if any
+		graph.Add(courses[kept]);
+		accepted.push_back(move(courses[kept]));
+	}
+	mergeSorted(accepted);
+}
+
+/*
+ * LoadSorted() loads the courses of a snapshot: sorted by courseId, IDs
+ * unique and free of cycles, with preReqIndex holding the index in
+ * courses of each prerequisite (two per course, -1 if none or not in the
+ * catalog). An empty catalog takes its graph straight from those edges
+ * and its tree from mergeSorted(), with no sorting, ID lookups or cycle
+ * checks. A catalog that already holds courses goes through BulkLoad().
+ *
+ * @param vector<Course>& courses (entries moved out), vector<int64_t>& preReqIndex
+ */
+void CourseCatalog::LoadSorted(vector<Course>& courses, const vector<int64_t>& preReqIndex) {
+	unique_lock<mutex> lock = lockWriters();
+	if (Size() == 0 && Prerequisites().AddSorted(courses, preReqIndex)) {
+		mergeSorted(courses);
+	}
+	else {
+		bulkLoad(courses);
+	}
+}
+
+/*
+ * DeleteCascade() deletes the courses in courseIds together with every
+ * course that depends on them, so a whole program can be retired at once
+ * without the dependency check refusing its lower courses. The closure
+ * comes from one walk of the prerequisite graph. A small cascade deletes
+ * the courses one at a time (eraseEach(), O(k log n)); one removing over
+ * 1/CASCADE_REBUILD_FRACTION of the catalog filters the sorted courses and
+ * rebuilds once (eraseSorted(), O(n)). Unknown IDs are skipped. Nothing
+ * is printed, the caller reports removed.
+ *
+ * @param vector<string>& courseIds, vector<string>& removed (dependents first)
+ */
+void CourseCatalog::DeleteCascade(const vector<string>& courseIds, vector<string>& removed) {
+	unique_lock<mutex> lock = lockWriters();
+	size_t first = removed.size();
+	Prerequisites().DependentClosure(courseIds, removed);
+	size_t count = removed.size() - first;
+	if (count == 0) {
+		return;
+	}
+
+	vector<string> doomed(removed.begin() + first, removed.end());
+	if (count * CASCADE_REBUILD_FRACTION <= Size()) {
+		eraseEach(doomed);
+	}
+	else {
+		sort(doomed.begin(), doomed.end());
+		eraseSorted(doomed);
+	}
+}
+
+/*
+ * SearchMany() looks up every ID in courseIds, putting the course (or
+ * nullptr if not found) for courseIds[i] in results[i]. This default calls
+ * Search() for each ID; catalogs override it to overlap the lookups.
+ *
+ * @param vector<string_view>& courseIds, vector<const Course*>& results
+ */
+void CourseCatalog::SearchMany(const vector<string_view>& courseIds, vector<const Course*>& results) const {
+	results.resize(courseIds.size());
+	for (size_t i = 0; i < courseIds.size(); ++i) {
+		results[i] = Search(courseIds[i]);
+	}
+}
+
+/*
+ * Verify() checks what every catalog guarantees: CollectCourses() lists
+ * Size() courses in strictly increasing courseId order, and Search() finds
+ * each of them at the same address. Catalogs extend it with checks of their
+ * own structure. Nothing is printed; problem says what is wrong.
+ *
+ * @param string& problem
+ * @return bool false if an invariant is broken
+ */
+bool CourseCatalog::Verify(string& problem) const {
+	vector<const Course*> sorted;
+	CollectCourses(sorted);
+	if (sorted.size() != Size()) {
+		problem = "Size() is " + to_string(Size()) + " but " + to_string(sorted.size()) + " courses are listed";
+		return false;
+	}
+	for (size_t i = 0; i < sorted.size(); ++i) {
+		if (i > 0 && !(sorted[i - 1]->courseId < sorted[i]->courseId)) {
+			problem = "courses out of order at " + sorted[i]->courseId;
+			return false;
+		}
+		if (Search(sorted[i]->courseId) != sorted[i]) {
+			problem = "Search() does not find " + sorted[i]->courseId;
+			return false;
+		}
+	}
+	return true;
+}
+
+
+/*
+ * CourseIterator walks a BinarySearchTree in courseId order in either
+ * direction. It keeps the path from the root to its node, since nodes have
+ * no parent links, so each step costs O(1) amortized and O(log n) at worst.
+ * The end iterator has an empty path; decrementing it moves to the last course.
+ * Any add or delete invalidates every iterator of the tree.
+ */
+class CourseIterator {
+private:
+	const Node* root;
+	vector<const Node*> path; //root ... current node
+
+	friend class BinarySearchTree;
+	CourseIterator(const Node* treeRoot) : root(treeRoot) {}
+	void pushLeftmost(const Node* node);
+	void pushRightmost(const Node* node);
+
+public:
+	using iterator_category = bidirectional_iterator_tag;
+	using value_type = Course;
+	using difference_type = ptrdiff_t;
+	using pointer = const Course*;
+	using reference = const Course&;
+
+	CourseIterator() : root(nullptr) {}
+	reference operator*() const { return path.back()->course; }
+	pointer operator->() const { return &path.back()->course; }
+	CourseIterator& operator++();
+	CourseIterator& operator--();
+	CourseIterator operator++(int) { CourseIterator before = *this; ++*this; return before; }
+	CourseIterator operator--(int) { CourseIterator before = *this; --*this; return before; }
+	bool operator==(const CourseIterator& other) const {
+		return (path.empty() ? nullptr : path.back()) == (other.path.empty() ? nullptr : other.path.back());
+	}
+	bool operator!=(const CourseIterator& other) const { return !(*this == other); }
+};
+
+//Pushes node and its chain of left children, ending at the subtree minimum
+void CourseIterator::pushLeftmost(const Node* node) {
+	for (; node != nullptr; node = node->left) {
+		path.push_back(node);
+	}
+}
+
+//Pushes node and its chain of right children, ending at the subtree maximum
+void CourseIterator::pushRightmost(const Node* node) {
+	for (; node != nullptr; node = node->right) {
+		path.push_back(node);
+	}
+}
+
+/*
+ * operator++ moves to the next course: the minimum of the right subtree,
+ * or else the nearest ancestor whose left subtree we are leaving
+ */
+CourseIterator& CourseIterator::operator++() {
+	const Node* node = path.back();
+	if (node->right != nullptr) {
+		pushLeftmost(node->right);
+		return *this;
+	}
+	path.pop_back();
+	while (!path.empty() && path.back()->right == node) {
+		node = path.back();
+		path.pop_back();
+	}
+	return *this;
+}
+
+/*
+ * operator-- is the mirror of operator++, and moves from end() to the last course
+ */
+CourseIterator& CourseIterator::operator--() {
+	if (path.empty()) {
+		pushRightmost(root);
+		return *this;
+	}
+	const Node* node = path.back();
+	if (node->left != nullptr) {
+		pushRightmost(node->left);
+		return *this;
+	}
+	path.pop_back();
+	while (!path.empty() && path.back()->left == node) {
+		node = path.back();
+		path.pop_back();
+	}
+	return *this;
+}
+
+
+class BinarySearchTree : public CourseCatalog {
+private:
+	Node* root;
+	NodePool pool; //Owns the storage of every node in the tree
+	size_t courseCount; //Number of courses (nodes) in the tree
+
+	CourseHashIndex index; //courseId -> course of every node, answers Search()
+	PrerequisiteGraph prerequisites; //Kept in sync by addNode() and deleteNode()
+
+	/*
+	 * Read-optimized copy of the tree used by SearchMany() while it is current.
+	 * Any add or delete makes it stale and SearchMany() falls back to the tree;
+	 * it is rebuilt once the stale lookups have paid for a rebuild.
+	 */
+	mutable FrozenCatalog frozen;
+	mutable bool frozenCurrent;
+	mutable size_t staleSearches;
+
+	Node* addNode(Node* node, Course&& course);
+	void inOrder(Node* node, OutputSink& sink);
+	Node* deleteNode(Node* node, const CourseKey& key, const string& courseId); //Enhancement to remove node with balancing
+	Node* detachMin(Node* node, Node*& minNode); //Unlinks the smallest node of a subtree (successor)
+
+	//AVL balancing helpers
+	int height(Node* node);
+	int balanceFactor(Node* node);
+	void updateNode(Node* node);
+	static size_t size(Node* node);
+	Node* rotateLeft(Node* node);
+	Node* rotateRight(Node* node);
+	Node* rebalance(Node* node);
+
+	void destroySubtree(Node* node); //Runs node destructors before the pool drops its slabs
+
+	//Bulk load helpers
+	void collectInOrder(Node* node, vector<Node*>& nodes) const;
+	void measureShape(const Node* node, size_t depth, TreeShape& shape) const;
+	Node* buildBalanced(vector<Node*>& nodes, size_t first, size_t last);
+	void mergeSorted(vector<Course>& courses) override;
+	void eraseEach(const vector<string>& courseIds) override;
+	void eraseSorted(const vector<string>& doomed) override;
+
+	int verifySubtree(const Node* node, string& problem) const; //Height, or -1 if broken
+
+	void invalidateFrozen(); //Called whenever the tree changes
+	void searchTreeMany(const string_view* courseIds, size_t count, const Course** results) const;
+
+	CourseIterator bound(string_view courseId, bool inclusive) const;
+	size_t countBelow(string_view courseId, bool inclusive) const;
+	CourseIterator select(size_t k) const;
+
+public:
+
+	BinarySearchTree();
+	~BinarySearchTree();
+	BinarySearchTree(const BinarySearchTree&) = delete; //Nodes belong to this tree's pool
+	BinarySearchTree& operator=(const BinarySearchTree&) = delete;
+	void InOrder(OutputSink& sink) override;
+	void DisplayNode(Node* node, OutputSink& sink);
+	bool InsertCourse(Course course) override;
+	const Course* Search(string_view courseId) const override;
+	void SearchMany(const vector<string_view>& courseIds, vector<const Course*>& results) const override;
+	void Freeze() const; //Rebuilds the read-optimized copy now
+	size_t Size() const override;
+	void CollectCourses(vector<const Course*>& sorted) const override;
+	void Shape(TreeShape& shape) const override;
+	PrerequisiteGraph& Prerequisites() override { return prerequisites; }
+	bool DeleteCourseWithDependencyCheck(const string& courseId) override; //Enhancement called from main to delete course.
+	bool Verify(string& problem) const override;
+
+	//Ordered iteration and range queries, O(log n + k) for k courses visited
+	CourseIterator begin() const;
+	CourseIterator end() const;
+	CourseIterator LowerBound(string_view courseId) const; //First course >= courseId
+	CourseIterator UpperBound(string_view courseId) const; //First course > courseId
+	pair<CourseIterator, CourseIterator> PrefixRange(string_view prefix) const; //Every course starting with prefix
+
+	//Order statistics from the subtree sizes, O(log n) each
+	size_t Rank(string_view courseId) const; //Courses ordered before courseId
+	const Course* Select(size_t k) const; //Course at position k (0-based), nullptr if k >= Size()
+	size_t CountInRange(string_view low, string_view high) const; //Courses with low <= ID <= high
+	void InOrderPage(size_t first, size_t count, OutputSink& sink) const override;
+};
+
+//default constructor
+BinarySearchTree::BinarySearchTree() {
+	//Set to empty
+	root = nullptr;
+	courseCount = 0;
+	frozenCurrent = false;
+	staleSearches = 0;
+}
+
+/*
+ * Destructor tears the tree down. Each course's strings are destroyed,
+ * then every slab of node storage is handed back in one pass.
+ */
+BinarySearchTree::~BinarySearchTree() {
+	destroySubtree(root);
+	root = nullptr;
+	pool.ReleaseAll();
+}
+
+/*
+ * destroySubtree() runs the destructor of every node below node
+ * (freeing the course strings) without returning nodes to the free list,
+ * since the pool is about to release the slabs in bulk.
+ *
+ * @param Node* node
+ */
+void BinarySearchTree::destroySubtree(Node* node) {
+	if (node != nullptr) {
+		destroySubtree(node->left);
+		destroySubtree(node->right);
+		node->~Node();
+	}
+}
+
+/*
+ * height() returns the stored height of a subtree,
+ * treating an empty subtree (nullptr) as height 0
+ *
+ * @param Node* node
+ * @return int height
+ */
+int BinarySearchTree::height(Node* node) {
+	return (node == nullptr) ? 0 : node->height;
+}
+
+/*
+ * balanceFactor() is the left subtree height minus the right
+ * subtree height. An AVL tree keeps this within -1..1 at every node.
+ *
+ * @param Node* node
+ * @return int balance
+ */
+int BinarySearchTree::balanceFactor(Node* node) {
+	return height(node->left) - height(node->right);
+}
+
+/*
+ * size() returns the stored course count of a subtree, 0 if empty
+ *
+ * @param Node* node
+ * @return size_t
+ */
+size_t BinarySearchTree::size(Node* node) {
+	return (node == nullptr) ? 0 : node->size;
+}
+
+/*
+ * updateNode() recomputes a node's height and subtree size from its children.
+ * Must be called bottom-up after any change below the node.
+ *
+ * @param Node* node
+ */
+void BinarySearchTree::updateNode(Node* node) {
+	int leftHeight = height(node->left);
+	int rightHeight = height(node->right);
+	node->height = 1 + (leftHeight > rightHeight ? leftHeight : rightHeight);
+	node->size = 1 + size(node->left) + size(node->right);
+}
+
+/*
+ * rotateLeft() lifts the right child into the node's place:
+ *
+ *      node                  pivot
+ *      /  \                  /   \
+ *     A   pivot     =>     node   C
+ *         /  \            /  \
+ *        B    C          A    B
+ *
+ * @param Node* node
+ * @return Node* new subtree root (pivot)
+ */
+Node* BinarySearchTree::rotateLeft(Node* node) {
+	Node* pivot = node->right;
+	node->right = pivot->left; //B moves under node
+	pivot->left = node;
+	updateNode(node); //node is now below pivot, so update it first
+	updateNode(pivot);
+	return pivot;
+}
+
+/*
+ * rotateRight() is the mirror of rotateLeft(), lifting the left child
+ *
+ * @param Node* node
+ * @return Node* new subtree root (pivot)
+ */
+Node* BinarySearchTree::rotateRight(Node* node) {
+	Node* pivot = node->left;
+	node->left = pivot->right; //B moves under node
+	pivot->right = node;
+	updateNode(node);
+	updateNode(pivot);
+	return pivot;
+}
+
+/*
+ * rebalance() is called on every node along the path back up from an
+ * insert or delete. It refreshes the node's height and size and, if the node is
+ * out of balance by 2, performs the single or double rotation that fixes it.
+ * Left-Left and Right-Right need one rotation, Left-Right and Right-Left
+ * rotate the child first and then the node.
+ *
+ * @param Node* node
+ * @return Node* root of the (possibly rotated) subtree
+ */
+Node* BinarySearchTree::rebalance(Node* node) {
+	updateNode(node);
+	int balance = balanceFactor(node);
+
+	if (balance > 1) { //Left heavy
+		if (balanceFactor(node->left) < 0) { //Left-Right case
+			node->left = rotateLeft(node->left);
+		}
+		return rotateRight(node);
+	}
+	if (balance < -1) { //Right heavy
+		if (balanceFactor(node->right) > 0) { //Right-Left case
+			node->right = rotateRight(node->right);
+		}
+		return rotateLeft(node);
+	}
+	return node; //already balanced
+}
+
+/*
+ * InsertCourse() function is called from Parser::Parser() to take a
+ * Node constructed from an input file read
+ * The tree is rebalanced on the way back up, so the height stays
+ * O(log n) even when the file is already sorted by course ID.
+ * The course is taken by value so callers can move it in, it is then
+ * moved (never copied) down the recursion into its node.
+ * A course whose prerequisites already depend on it is refused, since it
+ * would close a prerequisite cycle.
+ *
+ * @param Course course (node structure)
+ * @return bool false if refused
+ */
+bool BinarySearchTree::InsertCourse(Course course) {
+	vector<string> cycle;
+	if (prerequisites.FindCycle(course, cycle)) {
+		ReportCycle(course.courseId, cycle);
+		return false;
+	}
+	invalidateFrozen();
+
+	STAT_DEPTH_BEGIN();
+	if (root == nullptr) { //if tree is empty
+		root = pool.Acquire(move(course)); //starts tree
+		prerequisites.Add(root->course);
+		index.Insert(&root->course);
+		++courseCount;
+	}
+	else { //tree not empty
+		root = this->addNode(root, move(course)); //root may change after a rotation
+	}
+	STAT_DEPTH_END(inserts, insertDepthTotal, insertDepthMax);
+	return true;
+}
+
+/*
+ * Recursive addNode() function that will build the BST
+ * using nodes and the courseId as the ordering factor
+ * Returns the root of the subtree after rebalancing so the
+ * caller can re-link it (a rotation may replace the node).
+ * A course ID that already exists replaces the stored course
+ * instead of adding a duplicate node (e.g. reloading the same file).
+ *
+ * @param Node node, Course&& course
+ * @return Node* subtree root
+ */
+Node* BinarySearchTree::addNode(Node* node, Course&& course) {
+	STAT_DEPTH_STEP();
+
+	int comparison = CompareCourseIds(node->key, node->course.courseId, CourseKey(course.courseId), course.courseId);
+
+	if (comparison > 0) { //course ID is less than current Node
+		if (node->left == nullptr) { //Left leaf empty
+			node->left = pool.Acquire(move(course)); //Assign to empty left
+			prerequisites.Add(node->left->course);
+			index.Insert(&node->left->course);
+			++courseCount;
+		}
+		else { //Left leaf not empty
+			node->left = this->addNode(node->left, move(course)); //Recurse down the left leaf
+		}
+	}
+	else if (comparison < 0) { //Course ID is greater than current Node
+		if (node->right == nullptr) { //Right leaf empty
+			node->right = pool.Acquire(move(course)); //Assign to empty right
+			prerequisites.Add(node->right->course);
+			index.Insert(&node->right->course);
+			++courseCount;
+		}
+		else { //Right leaf not empty
+			node->right = this->addNode(node->right, move(course)); //Recurse down right leaf
+		}
+	}
+	else { //Course ID already in tree, update it in place
+		prerequisites.Remove(node->course); //prerequisites may have changed
+		node->course = move(course);
+		prerequisites.Add(node->course);
+		return node; //shape unchanged, nothing to rebalance
+	}
+	return rebalance(node);
+}
+
+/*
+ * mergeSorted() puts courses (sorted, IDs unique, already in the graph)
+ * into the tree, replacing stored courses with the same ID in place, and
+ * relinks it as a perfectly balanced AVL tree in one pass over the
+ * in-order node list, O(n + m)
+ *
+ * @param vector<Course>& courses (entries moved out)
+ */
+void BinarySearchTree::mergeSorted(vector<Course>& courses) {
+	invalidateFrozen();
+	index.Reserve(courseCount + courses.size());
+	vector<Node*> existing;
+	existing.reserve(courseCount);
+	collectInOrder(root, existing);
+
+	vector<Node*> merged;
+	merged.reserve(existing.size() + courses.size());
+	size_t e = 0;
+	for (Course& aCourse : courses) {
+		while (e < existing.size() && existing[e]->course.courseId < aCourse.courseId) {
+			merged.push_back(existing[e++]);
+		}
+		if (e < existing.size() && existing[e]->course.courseId == aCourse.courseId) { //Same node, the index still points at it
+			existing[e]->course = move(aCourse);
+			merged.push_back(existing[e++]);
+		}
+		else {
+			Node* node = pool.Acquire(move(aCourse));
+			index.Insert(&node->course);
+			merged.push_back(node);
+		}
+	}
+	while (e < existing.size()) {
+		merged.push_back(existing[e++]);
+	}
+
+	root = buildBalanced(merged, 0, merged.size());
+	courseCount = merged.size();
+}
+
+/*
+ * collectInOrder() appends every node of the subtree to nodes
+ * in courseId order
+ *
+ * @param Node* node, vector<Node*>& nodes
+ */
+void BinarySearchTree::collectInOrder(Node* node, vector<Node*>& nodes) const {
+	if (node != nullptr) {
+		collectInOrder(node->left, nodes);
+		nodes.push_back(node);
+		collectInOrder(node->right, nodes);
+	}
+}
+
+/*
+ * buildBalanced() links the sorted nodes[first, last) into a height
+ * balanced subtree. The middle node becomes the root and each half is
+ * built the same way, so sibling subtrees differ in height by at most one.
+ *
+ * @param vector<Node*>& nodes, size_t first, size_t last
+ * @return Node* subtree root
+ */
+Node* BinarySearchTree::buildBalanced(vector<Node*>& nodes, size_t first, size_t last) {
+	if (first >= last) {
+		return nullptr;
+	}
+	size_t middle = first + (last - first) / 2;
+	Node* node = nodes[middle];
+	node->left = buildBalanced(nodes, first, middle);
+	node->right = buildBalanced(nodes, middle + 1, last);
+	updateNode(node);
+	return node;
+}
+
+/*
+ * InOrder() function designed to recursively travel down a tree
+ * Called once from main print option
+ * calls inOrder() function, passing the current root as node
+ *
+ * @param OutputSink sink
+ */
+
+void BinarySearchTree::InOrder(OutputSink& sink) {
+	this->inOrder(root, sink);
+}
+
+/*
+ * Recursive inOrder() function that traveses down
+ * the left side of the tree, printing from left to right
+ * With DisplayNode() function call, and moving up
+ * a node with each traversal
+ * Called once from main as option 2
+ *
+ * @param Node node, OutputSink sink
+ */
+
+void BinarySearchTree::inOrder(Node* node, OutputSink& sink) {
+	if (node != nullptr) { //If node not empty
+		inOrder(node->left, sink); //check left
+		DisplayNode(node, sink); //print current
+		inOrder(node->right, sink); //check right
+	}
+}
+
+
+/*
+ * DisplayNode() function called from inOrder() function
+ * Purpose is to display courseId and courseName
+ * Formats into the sink's buffer, nothing is flushed per course
+ *
+ * @param Node node, OutputSink sink
+ */
+void BinarySearchTree::DisplayNode(Node* node, OutputSink& sink) {
+	sink.Write(node->course.courseId);
+	sink.Write(", ");
+	sink.Write(node->course.courseName);
+	sink.Put('\n');
+	return;
+}
+
+/*
+ * Search() function designed to take user input of courseId
+ * called from menu option 3. Exact IDs are answered by the hash index,
+ * so the cost does not depend on the shape of the tree; ordered queries
+ * (InOrder(), ranges) still walk the tree.
+ * The course is returned by pointer into its node, not copied. The pointer
+ * stays valid until that course is deleted or replaced.
+ *
+ * @param string_view courseId
+ * @return const Course* course
+*/
+const Course* BinarySearchTree::Search(string_view courseId) const {
+	STAT_ADD(searches, 1);
+	return index.Find(courseId);
+}
+
+/*
+ * SearchMany() looks up a batch of IDs (e.g. a whole transcript), with
+ * results in input order. The batch is split into groups of SEARCH_GROUP
+ * lookups that walk the frozen copy, or the tree while it is stale, in lockstep.
+ * Once the tree has answered as many of these lookups since the last change
+ * as there are courses, the frozen copy is rebuilt, so the O(n) rebuild is
+ * spread over at least n lookups.
+ *
+ * @param vector<string_view>& courseIds, vector<const Course*>& results
+ */
+void BinarySearchTree::SearchMany(const vector<string_view>& courseIds, vector<const Course*>& results) const {
+	results.resize(courseIds.size());
+	STAT_ADD(searches, courseIds.size());
+	for (size_t first = 0; first < courseIds.size(); first += SEARCH_GROUP) {
+		size_t count = min(SEARCH_GROUP, courseIds.size() - first);
+		if (!frozenCurrent) {
+			staleSearches += count;
+			if (staleSearches > courseCount) { //Enough lookups to pay for a rebuild
+				Freeze();
+			}
+		}
+		if (frozenCurrent) {
+			frozen.SearchMany(&courseIds[first], count, &results[first]);
+		}
+		else {
+			searchTreeMany(&courseIds[first], count, &results[first]);
+		}
+	}
+}
+
+/*
+ * searchTreeMany() walks the tree for up to SEARCH_GROUP IDs at once.
+ * Every round moves each unfinished lookup to its next node and prefetches
+ * it, then goes on to the other lookups while that node is loaded.
+ *
+ * @param courseIds, size_t count (<= SEARCH_GROUP), results (count entries)
+ */
+void BinarySearchTree::searchTreeMany(const string_view* courseIds, size_t count, const Course** results) const {
+	CourseKey searchKeys[SEARCH_GROUP];
+	Node* cursors[SEARCH_GROUP];
+	size_t walking = 0;
+
+	for (size_t j = 0; j < count; ++j) {
+		searchKeys[j] = CourseKey(courseIds[j]);
+		cursors[j] = root;
+		results[j] = nullptr;
+		if (root != nullptr) {
+			++walking;
+		}
+	}
+
+	while (walking > 0) {
+		for (size_t j = 0; j < count; ++j) {
+			Node* node = cursors[j];
+			if (node == nullptr) { //This lookup is finished
+				continue;
+			}
+			int comparison = CompareKeys(node->key, searchKeys[j]);
+			if (comparison == 0) { //Keys tie, long IDs may still differ
+				comparison = CompareCourseIds(node->key, node->course.courseId, searchKeys[j], courseIds[j]);
+			}
+			if (comparison == 0) {
+				results[j] = &node->course;
+				node = nullptr;
+			}
+			else {
+				node = (comparison > 0) ? node->left : node->right;
+			}
+			if (node != nullptr) {
+				PREFETCH(node);
+			}
+			else {
+				--walking;
+			}
+			cursors[j] = node;
+		}
+	}
+}
+
+/*
+ * Freeze() compiles the current tree into the read-optimized
+ * FrozenCatalog that SearchMany() uses until the next add or delete
+ */
+void BinarySearchTree::Freeze() const {
+	vector<Node*> nodes;
+	nodes.reserve(courseCount);
+	collectInOrder(root, nodes);
+
+	vector<const Course*> sorted;
+	sorted.reserve(nodes.size());
+	for (Node* node : nodes) {
+		sorted.push_back(&node->course);
+	}
+	frozen.Build(sorted);
+	frozenCurrent = true;
+}
+
+/*
+ * invalidateFrozen() marks the frozen copy stale after a change,
+ * so SearchMany() goes back to the tree until it is rebuilt
+ */
+void BinarySearchTree::invalidateFrozen() {
+	frozenCurrent = false;
+	staleSearches = 0;
+}
+
+/*
+ * begin() is the first course in courseId order, end() is one past the last
+ *
+ * @return CourseIterator
+ */
+CourseIterator BinarySearchTree::begin() const {
+	CourseIterator first(root);
+	first.pushLeftmost(root);
+	return first;
+}
+
+CourseIterator BinarySearchTree::end() const {
+	return CourseIterator(root);
+}
+
+/*
+ * bound() walks down to courseId, remembering the last node that was
+ * not smaller (inclusive) or was larger (exclusive). That node's path is
+ * a prefix of the walk, so the iterator is the walk cut back to it.
+ *
+ * @param string_view courseId, bool inclusive
+ * @return CourseIterator
+ */
+CourseIterator BinarySearchTree::bound(string_view courseId, bool inclusive) const {
+	CourseIterator found(root);
+	CourseKey key(courseId);
+	size_t depth = 0; //Path length up to the best candidate so far, 0 = end()
+
+	for (Node* node = root; node != nullptr;) {
+		found.path.push_back(node);
+		int comparison = CompareCourseIds(node->key, node->course.courseId, key, courseId);
+		if (comparison > 0 || (inclusive && comparison == 0)) { //Candidate, look for a smaller one
+			depth = found.path.size();
+			node = node->left;
+		}
+		else {
+			node = node->right;
+		}
+	}
+	found.path.resize(depth);
+	return found;
+}
+
+/*
+ * LowerBound() returns the first course whose ID is not less than courseId,
+ * e.g. [LowerBound("CSCI300"), UpperBound("CSCI399")) is CSCI300 through CSCI399
+ *
+ * @param string_view courseId
+ * @return CourseIterator (end() if none)
+ */
+CourseIterator BinarySearchTree::LowerBound(string_view courseId) const {
+	return bound(courseId, true);
+}
+
+/*
+ * UpperBound() returns the first course whose ID is greater than courseId
+ *
+ * @param string_view courseId
+ * @return CourseIterator (end() if none)
+ */
+CourseIterator BinarySearchTree::UpperBound(string_view courseId) const {
+	return bound(courseId, false);
+}
+
+/*
+ * PrefixRange() returns the range of courses whose ID starts with prefix,
+ * e.g. "MATH". The range ends at the first ID not less than the prefix with
+ * its last byte incremented (trailing 0xFF bytes dropped first).
+ *
+ * @param string_view prefix
+ * @return pair<CourseIterator, CourseIterator> [first, last)
+ */
+pair<CourseIterator, CourseIterator> BinarySearchTree::PrefixRange(string_view prefix) const {
+	string limit(prefix);
+	while (!limit.empty() && static_cast<unsigned char>(limit.back()) == 0xFF) {
+		limit.pop_back();
+	}
+	if (limit.empty()) { //Empty prefix (or all 0xFF), runs to the end
+		return make_pair(LowerBound(prefix), end());
+	}
+	limit.back() = static_cast<char>(static_cast<unsigned char>(limit.back()) + 1);
+	return make_pair(LowerBound(prefix), LowerBound(limit));
+}
+
+/*
+ * countBelow() counts the courses smaller than courseId (or not larger, if
+ * inclusive) by adding up the left subtree sizes skipped on the way down
+ *
+ * @param string_view courseId, bool inclusive
+ * @return size_t
+ */
+size_t BinarySearchTree::countBelow(string_view courseId, bool inclusive) const {
+	CourseKey key(courseId);
+	size_t below = 0;
+
+	for (Node* node = root; node != nullptr;) {
+		int comparison = CompareCourseIds(node->key, node->course.courseId, key, courseId);
+		if (comparison < 0 || (inclusive && comparison == 0)) { //node and its left subtree come first
+			below += size(node->left) + 1;
+			node = node->right;
+		}
+		else {
+			node = node->left;
+		}
+	}
+	return below;
+}
+
+/*
+ * Rank() returns the position courseId has (or would have) in the
+ * course list, i.e. the number of courses with a smaller ID
+ *
+ * @param string_view courseId
+ * @return size_t
+ */
+size_t BinarySearchTree::Rank(string_view courseId) const {
+	return countBelow(courseId, false);
+}
+
+/*
+ * CountInRange() counts the courses from low through high, both included
+ *
+ * @param string_view low, string_view high
+ * @return size_t
+ */
+size_t BinarySearchTree::CountInRange(string_view low, string_view high) const {
+	size_t upTo = countBelow(high, true);
+	size_t before = countBelow(low, false);
+	return upTo > before ? upTo - before : 0;
+}
+
+/*
+ * select() walks down to the course at position k, steering by the left
+ * subtree sizes, and returns an iterator on it (end() if k >= Size())
+ *
+ * @param size_t k (0-based)
+ * @return CourseIterator
+ */
+CourseIterator BinarySearchTree::select(size_t k) const {
+	CourseIterator found(root);
+	if (k >= size(root)) {
+		return found;
+	}
+	Node* node = root;
+	while (true) {
+		found.path.push_back(node);
+		size_t leftSize = size(node->left);
+		if (k < leftSize) {
+			node = node->left;
+		}
+		else if (k == leftSize) {
+			return found;
+		}
+		else {
+			k -= leftSize + 1;
+			node = node->right;
+		}
+	}
+}
+
+/*
+ * Select() returns the course at position k of the course list
+ *
+ * @param size_t k (0-based)
+ * @return const Course* or nullptr if k >= Size()
+ */
+const Course* BinarySearchTree::Select(size_t k) const {
+	CourseIterator found = select(k);
+	return found == end() ? nullptr : &*found;
+}
+
+/*
+ * InOrderPage() jumps to position first with select() and walks count
+ * courses from there, O(log n + count) instead of a full traversal
+ *
+ * @param size_t first, size_t count, OutputSink sink
+ */
+void BinarySearchTree::InOrderPage(size_t first, size_t count, OutputSink& sink) const {
+	CourseIterator last = end();
+	for (CourseIterator it = select(first); it != last && count > 0; ++it, --count) {
+		sink.Write(it->courseId);
+		sink.Write(", ");
+		sink.Write(it->courseName);
+		sink.Put('\n');
+	}
+}
+
+/*
+ * Size() returns the number of courses in the tree
+ *
+ * @return size_t
+ */
+size_t BinarySearchTree::Size() const {
+	return courseCount;
+}
+
+/*
+ * CollectCourses() appends every course in courseId order
+ *
+ * @param vector<const Course*>& sorted
+ */
+void BinarySearchTree::CollectCourses(vector<const Course*>& sorted) const {
+	vector<Node*> nodes;
+	nodes.reserve(courseCount);
+	collectInOrder(root, nodes);
+	for (Node* node : nodes) {
+		sorted.push_back(&node->course);
+	}
+}
+
+/*
+ * Shape() counts the courses at each depth of the tree
+ *
+ * @param TreeShape& shape
+ */
+void BinarySearchTree::Shape(TreeShape& shape) const {
+	measureShape(root, 1, shape);
+}
+
+void BinarySearchTree::measureShape(const Node* node, size_t depth, TreeShape& shape) const {
+	if (node != nullptr) {
+		shape.Add(depth);
+		measureShape(node->left, depth + 1, shape);
+		measureShape(node->right, depth + 1, shape);
+	}
+}
+
+/*
+ *  deleteNode()
+ *  This function is designed to remove the node then will use a balancing algorithm
+ *  to rebalance the AVL tree once the node is removed. To find the node to delete,
+ *  the function will be recursively called passing the last node checked as the current
+ *  node to check, traversing according to the courseId down the tree using comparisons.
+ *  Every node on the way back up is passed through rebalance().
+ *  This function is called from DeleteNodeWithDependencyCheck() to ensure that it has
+ *  no dependencies (it is not a prerequisite for another course).
+ *  @params Node* node, const CourseKey& key (packed courseId), const string& courseId
+ *  return node
+ */
+Node* BinarySearchTree::deleteNode(Node* node, const CourseKey& key, const string& courseId) {
+
+	if (node == nullptr) { //If node is empty
+		return nullptr; //node not found
+	}
+	STAT_DEPTH_STEP();
+
+	int comparison = CompareCourseIds(key, courseId, node->key, node->course.courseId);
+
+	//Traverse left if courseID is smaller
+	if (comparison < 0) {
+		node->left = deleteNode(node->left, key, courseId);
+	}
+
+	//Traverse right if courseId is larger
+	else if (comparison > 0) {
+		node->right = deleteNode(node->right, key, courseId);
+	}
+
+	/*
+	 *  This else statement shows the node has been found.
+	 *  The successor algorithm below removes the node, and the
+	 *  rebalance() calls on the way back up rotate the tree
+	 *  to keep it balanced.
+	 */
+	else { //node to delete is found
+
+		//The course is leaving the tree, so it no longer depends on its prerequisites
+		prerequisites.Remove(node->course);
+		index.Erase(courseId);
+		--courseCount;
+
+		//Case 1, no children
+		if (node->left == nullptr && node->right == nullptr) {
+			pool.Release(node);
+			return nullptr;
+		}
+
+		//Case 2, one child
+		else if (node->left == nullptr) { //right child exists
+			Node* tempNode = node->right; //Grab the right child
+			pool.Release(node); //remove right's parent node
+			return tempNode; //replace deleted node with right node
+		}
+		else if (node->right == nullptr) { //left child exists
+			Node* tempNode = node->left; //Grab left child
+			pool.Release(node); //remove left's parent node
+			return tempNode; //replace delted node with left node
+		}
+
+		/*
+		 * Case 3, two children
+		 * This is a more complicated tree. A BST tree
+		 * uses branches, so if we have a parent node, a left is less than
+		 * a right is greater than, but we need the IMMEDIATE successor
+		 * (nearest higher value) to the parent node to replace it. To do this,
+		 * we find the smallest value of the right subtree. So, traverse right,
+		 * then traverse left until left is null pointer. This ensures we
+		 * have the immediate next value from the parent node.
+		 * Rather than copying the successor's course into this node, the successor
+		 * node itself is unlinked from the right subtree (rebalancing that path)
+		 * and takes over the deleted node's children.
+		 */
+		else {
+			Node* successor = nullptr;
+			Node* rightSubtree = detachMin(node->right, successor); //finds and unlinks successor
+
+			successor->left = node->left; //successor adopts both subtrees
+			successor->right = rightSubtree;
+			pool.Release(node);
+			return rebalance(successor);
+		}
+	}
+	return rebalance(node);
+}
+
+/*
+ *  detachMin()
+ *  Walks left from node to the smallest course in the subtree, unlinks it
+ *  (its right child takes its place) and rebalances each node on the way back up.
+ *  Used by deleteNode() to pull out the in-order successor.
+ *  @params Node* node, Node*& minNode (set to the unlinked node)
+ *  return Node* subtree root without the minimum
+ */
+Node* BinarySearchTree::detachMin(Node* node, Node*& minNode) {
+	STAT_DEPTH_STEP();
+	if (node->left == nullptr) { //No smaller course, this is the successor
+		minNode = node;
+		return node->right;
+	}
+	node->left = detachMin(node->left, minNode); //keep moving left to find true successor
+	return rebalance(node);
+}
+
+/*
+ * DeleteCourseWithDependencyCheck()
+ * This is the function that is called from main (option 5).
+ * It is a wrapper class for the dependency check (which checks to ensure
+ * that the course to be deleted is not a prerquisite to another active
+ * course in the tree) and deleteNode() which will recursively delete the node
+ * if it exists in the tree and is safe to delete (not a dependency).
+ * @param string courseId
+ * @return boolean
+ */
+bool BinarySearchTree::DeleteCourseWithDependencyCheck(const string& courseId) {
+	const Course* userCourseToDelete = Search(courseId); //Find the course to delete
+
+	//if course to delete not found
+	if (userCourseToDelete == nullptr) {
+		cout << "Error: " << courseId << " doesn't exist." << endl;
+		return false;
+	}
+
+	//if course to delete is a dependency
+	if (prerequisites.IsPrerequisite(courseId)) {
+		cout << "Error: Can not delete " << courseId
+			<< ". It is a prerequisite to another course." << endl;
+		return false;
+	}
+
+	// delete node if found and if not a dependency
+	invalidateFrozen();
+	STAT_DEPTH_BEGIN();
+	root = deleteNode(root, CourseKey(courseId), courseId);
+	STAT_DEPTH_END(deletes, deleteDepthTotal, deleteDepthMax);
+	cout << courseId << " has been successfully deleted." << endl;
+	return true;
+
+}
+
+/*
+ * eraseEach() deletes the courses one at a time, as a cascade does when it
+ * is small next to the tree
+ *
+ * @param vector<string>& courseIds (stored, dependents first)
+ */
+void BinarySearchTree::eraseEach(const vector<string>& courseIds) {
+	invalidateFrozen();
+	for (const string& courseId : courseIds) {
+		STAT_DEPTH_BEGIN();
+		root = deleteNode(root, CourseKey(courseId), courseId);
+		STAT_DEPTH_END(deletes, deleteDepthTotal, deleteDepthMax);
+	}
+}
+
+/*
+ * eraseSorted() filters the doomed courses out of the in-order node list
+ * (both sorted by ID, so one merge pass) and rebuilds the tree balanced
+ *
+ * @param vector<string>& doomed (stored, sorted by courseId)
+ */
+void BinarySearchTree::eraseSorted(const vector<string>& doomed) {
+	invalidateFrozen();
+	vector<Node*> nodes;
+	nodes.reserve(courseCount);
+	collectInOrder(root, nodes);
+
+	vector<Node*> kept;
+	kept.reserve(nodes.size() - doomed.size());
+	size_t d = 0;
+	for (Node* node : nodes) {
+		if (d < doomed.size() && node->course.courseId == doomed[d]) {
+			++d;
+			prerequisites.Remove(node->course);
+			index.Erase(node->course.courseId);
+			pool.Release(node);
+		}
+		else {
+			kept.push_back(node);
+		}
+	}
+	root = buildBalanced(kept, 0, kept.size());
+	courseCount = kept.size();
+}
+
+/*
+ * Verify() adds the AVL invariants to the generic checks: every stored
+ * height and subtree size matches the children, sibling heights differ by
+ * at most one, and each node's packed key belongs to its course. The hash
+ * index must point at exactly the tree's courses (CourseHashIndex::Verify()).
+ *
+ * @param string& problem
+ * @return bool false if an invariant is broken
+ */
+bool BinarySearchTree::Verify(string& problem) const {
+	if (!CourseCatalog::Verify(problem) || verifySubtree(root, problem) < 0) {
+		return false;
+	}
+	if (size(root) != courseCount) {
+		problem = "root size " + to_string(size(root)) + " but " + to_string(courseCount) + " courses";
+		return false;
+	}
+	return index.Verify(courseCount, problem);
+}
+
+int BinarySearchTree::verifySubtree(const Node* node, string& problem) const {
+	if (node == nullptr) {
+		return 0;
+	}
+	int leftHeight = verifySubtree(node->left, problem);
+	int rightHeight = leftHeight < 0 ? -1 : verifySubtree(node->right, problem);
+	if (rightHeight < 0) {
+		return -1;
+	}
+	const string& courseId = node->course.courseId;
+	if (leftHeight - rightHeight > 1 || rightHeight - leftHeight > 1) {
+		problem = "unbalanced at " + courseId;
+		return -1;
+	}
+	if (node->height != 1 + max(leftHeight, rightHeight)
+		|| node->size != 1 + (node->left == nullptr ? 0 : node->left->size) + (node->right == nullptr ? 0 : node->right->size)) {
+		problem = "stale height or size at " + courseId;
+		return -1;
+	}
+	if (CompareKeys(node->key, CourseKey(courseId)) != 0) {
+		problem = "wrong key at " + courseId;
+		return -1;
+	}
+	if (index.Find(courseId) != &node->course) {
+		problem = "index does not point at " + courseId;
+		return -1;
+	}
+	return node->height;
+}
+
+const int BTREE_MIN_DEGREE = 8; //t: every node but the root holds t - 1 to 2t - 1 keys
+
+/*
+ * BTreeNode is one wide, cache-line aligned node of the B-tree.
+ * Keys are kept apart from the course records, so a search only touches
+ * the key arrays until it finds a match. The packed keys are split into
+ * separate high and low arrays so the high words can be compared several
+ * at a time with SIMD. A node with n keys has n + 1 children unless it is a leaf.
+ */
+struct alignas(64) BTreeNode {
+	static const int MAX_KEYS = 2 * BTREE_MIN_DEGREE - 1;
+	static const int KEY_LANES = MAX_KEYS + 1; //Key arrays padded to a multiple of 4 for SIMD loads
+
+	uint64_t keyHigh[KEY_LANES]; //CourseKey::high of each key
+	uint64_t keyLow[KEY_LANES];  //CourseKey::low of each key
+	int count;  //Keys in use
+	bool leaf;
+	Course* records[MAX_KEYS];           //Out-of-line course for each key
+	BTreeNode* children[MAX_KEYS + 1];
+
+	BTreeNode() {
+		count = 0;
+		leaf = true;
+		memset(keyHigh, 0, sizeof(keyHigh));
+		memset(keyLow, 0, sizeof(keyLow));
+	}
+
+	CourseKey Key(int i) const {
+		return CourseKey(keyHigh[i], keyLow[i]);
+	}
+
+	//Stores key and record in slot i
+	void SetSlot(int i, const CourseKey& key, Course* record) {
+		keyHigh[i] = key.high;
+		keyLow[i] = key.low;
+		records[i] = record;
+	}
+
+	//Copies slot j of from into slot i
+	void CopySlot(int i, const BTreeNode* from, int j) {
+		keyHigh[i] = from->keyHigh[j];
+		keyLow[i] = from->keyLow[j];
+		records[i] = from->records[j];
+	}
+};
+
+/*
+ * CountKeysBelow() returns how many of the first count sorted words in keys
+ * are smaller than query, which is the slot where a search continues.
+ * All KEY_LANES lanes are compared at once with AVX2 (4 per instruction)
+ * or SSE4.2 (2 per instruction) when the compiler targets them, and lanes
+ * past count are masked off. SIMD compares are signed, so both sides have
+ * their top bit flipped first to compare as unsigned.
+ * Without SIMD it is a branch-free loop.
+ * The paths are picked at compile time: GCC and Clang need -mavx2 or
+ * -msse4.2, and MSVC defines __AVX2__ only with /arch:AVX2, which the x64
+ * configurations of both projects set (MSVC has no SSE4.2 switch, so its
+ * other builds take the loop). Those builds need a CPU with AVX2.
+ *
+ * @param const uint64_t* keys (KEY_LANES words), int count, uint64_t query
+ * @return int
+ */
+inline int CountKeysBelow(const uint64_t* keys, int count, uint64_t query) {
+#if defined(__AVX2__)
+	const __m256i flip = _mm256_set1_epi64x(static_cast<long long>(0x8000000000000000ULL));
+	const __m256i target = _mm256_xor_si256(_mm256_set1_epi64x(static_cast<long long>(query)), flip);
+	unsigned below = 0;
+	for (int lane = 0; lane < BTreeNode::KEY_LANES; lane += 4) {
+		__m256i words = _mm256_xor_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(keys + lane)), flip);
+		__m256i less = _mm256_cmpgt_epi64(target, words);
+		below |= static_cast<unsigned>(_mm256_movemask_pd(_mm256_castsi256_pd(less))) << lane;
+	}
+	return POPCOUNT(below & ((1u << count) - 1));
+#elif defined(__SSE4_2__)
+	const __m128i flip = _mm_set1_epi64x(static_cast<long long>(0x8000000000000000ULL));
+	const __m128i target = _mm_xor_si128(_mm_set1_epi64x(static_cast<long long>(query)), flip);
+	unsigned below = 0;
+	for (int lane = 0; lane < BTreeNode::KEY_LANES; lane += 2) {
+		__m128i words = _mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(keys + lane)), flip);
+		__m128i less = _mm_cmpgt_epi64(target, words);
+		below |= static_cast<unsigned>(_mm_movemask_pd(_mm_castsi128_pd(less))) << lane;
+	}
+	return POPCOUNT(below & ((1u << count) - 1));
+#else
+	int below = 0;
+	for (int lane = 0; lane < count; ++lane) {
+		below += (keys[lane] < query) ? 1 : 0;
+	}
+	return below;
+#endif
+}
+
+
+/*
+ * CourseBTree is the B-tree alternative to BinarySearchTree. Courses are
+ * stored once, out of line, and the tree only holds compact keys and
+ * pointers to them, so many keys share a cache line during a search.
+ * Selected at startup with --btree.
+ */
+class CourseBTree : public CourseCatalog {
+private:
+	BTreeNode* root;
+	size_t courseCount;
+	deque<Course> records;       //Course storage, addresses never move
+	vector<Course*> freeRecords; //Deleted records waiting to be reused
+	PrerequisiteGraph prerequisites;
+
+	Course* newRecord(Course&& course);
+	BTreeNode* newNode();
+	void freeRecord(Course* record);
+
+	int compare(const BTreeNode* node, int i, const CourseKey& key, string_view courseId) const;
+	int findSlot(const BTreeNode* node, const CourseKey& key, string_view courseId, bool& found) const;
+	void insertAt(BTreeNode* node, int i, const CourseKey& key, Course* record);
+	void removeAt(BTreeNode* node, int i);
+
+	void splitChild(BTreeNode* parent, int i);
+	void insertNonFull(BTreeNode* node, const CourseKey& key, Course* record);
+	void mergeChildren(BTreeNode* node, int i);
+	void fillChild(BTreeNode* node, int i);
+	void removeKey(BTreeNode* node, const CourseKey& key, string_view courseId);
+	void eraseRecord(Course* record);
+	void buildFromSorted(const vector<Course*>& sorted);
+	void mergeSorted(vector<Course>& courses) override;
+	void eraseEach(const vector<string>& courseIds) override;
+	void eraseSorted(const vector<string>& doomed) override;
+
+	void inOrder(BTreeNode* node, OutputSink& sink);
+	void collectInOrder(BTreeNode* node, vector<Course*>& sorted) const;
+	void measureShape(const BTreeNode* node, size_t depth, TreeShape& shape) const;
+	size_t verifyNode(const BTreeNode* node, size_t depth, size_t& leafDepth, string& problem) const;
+	void destroy(BTreeNode* node);
+
+public:
+	CourseBTree();
+	~CourseBTree();
+	CourseBTree(const CourseBTree&) = delete;
+	CourseBTree& operator=(const CourseBTree&) = delete;
+
+	void InOrder(OutputSink& sink) override;
+	bool InsertCourse(Course course) override;
+	const Course* Search(string_view courseId) const override;
+	size_t Size() const override;
+	bool DeleteCourseWithDependencyCheck(const string& courseId) override;
+	void CollectCourses(vector<const Course*>& sorted) const override;
+	void Shape(TreeShape& shape) const override;
+	PrerequisiteGraph& Prerequisites() override { return prerequisites; }
+	bool Verify(string& problem) const override;
+};
+
+CourseBTree::CourseBTree() {
+	root = nullptr;
+	courseCount = 0;
+}
+
+CourseBTree::~CourseBTree() {
+	destroy(root);
+}
+
+/*
+ * destroy() frees every node below node (records belong to the deque)
+ *
+ * @param BTreeNode* node
+ */
+void CourseBTree::destroy(BTreeNode* node) {
+	if (node == nullptr) {
+		return;
+	}
+	if (!node->leaf) {
+		for (int i = 0; i <= node->count; ++i) {
+			destroy(node->children[i]);
+		}
+	}
+	delete node;
+}
+
+/*
+ * newRecord() stores course out of line, reusing a deleted record if any
+ *
+ * @param Course&& course
+ * @return Course* record
+ */
+Course* CourseBTree::newRecord(Course&& course) {
+	if (!freeRecords.empty()) {
+		Course* record = freeRecords.back();
+		freeRecords.pop_back();
+		*record = move(course);
+		return record;
+	}
+	records.push_back(move(course));
+	return &records.back();
+}
+
+/*
+ * newNode() allocates an empty leaf node
+ *
+ * @return BTreeNode*
+ */
+BTreeNode* CourseBTree::newNode() {
+	STAT_ADD(allocations, 1);
+	STAT_ADD(allocatedBytes, sizeof(BTreeNode));
+	return new BTreeNode();
+}
+
+/*
+ * freeRecord() releases a deleted course's strings and keeps its slot for reuse
+ *
+ * @param Course* record
+ */
+void CourseBTree::freeRecord(Course* record) {
+	*record = Course();
+	freeRecords.push_back(record);
+}
+
+/*
+ * compare() orders key slot i of node against a search key:
+ * < 0 if the slot is smaller, 0 if equal, > 0 if larger.
+ * The packed keys decide unless they tie and an ID is too long to fit,
+ * then the full course IDs are compared.
+ *
+ * @param node, int i, CourseKey key, string_view courseId
+ * @return int
+ */
+int CourseBTree::compare(const BTreeNode* node, int i, const CourseKey& key, string_view courseId) const {
+	int comparison = CompareKeys(node->Key(i), key);
+	if (comparison == 0) { //Keys tie, long IDs may still differ
+		comparison = CompareCourseIds(node->Key(i), node->records[i]->courseId, key, courseId);
+	}
+	return comparison;
+}
+
+/*
+ * findSlot() returns the first key slot of node that is not smaller
+ * than courseId (count if all are smaller), setting found on an exact match.
+ * The high words of all keys are compared at once by CountKeysBelow(),
+ * which skips every key that is smaller on its high word alone; only keys
+ * sharing the high word are then compared one at a time.
+ *
+ * @param node, CourseKey key, string_view courseId, bool& found
+ * @return int slot
+ */
+int CourseBTree::findSlot(const BTreeNode* node, const CourseKey& key, string_view courseId, bool& found) const {
+	int i = CountKeysBelow(node->keyHigh, node->count, key.high);
+	int comparison = 1;
+	while (i < node->count && (comparison = compare(node, i, key, courseId)) < 0) {
+		++i;
+	}
+	found = (i < node->count && comparison == 0);
+	return i;
+}
+
+/*
+ * insertAt() shifts node's keys right to place key/record at slot i
+ * (children are shifted by the callers that need it)
+ */
+void CourseBTree::insertAt(BTreeNode* node, int i, const CourseKey& key, Course* record) {
+	for (int j = node->count; j > i; --j) {
+		node->CopySlot(j, node, j - 1);
+	}
+	node->SetSlot(i, key, record);
+	++node->count;
+}
+
+/*
+ * removeAt() shifts node's keys left over slot i
+ */
+void CourseBTree::removeAt(BTreeNode* node, int i) {
+	for (int j = i; j + 1 < node->count; ++j) {
+		node->CopySlot(j, node, j + 1);
+	}
+	--node->count;
+}
+
+/*
+ * Search() walks down from the root, scanning each node's keys
+ *
+ * @param string_view courseId
+ * @return const Course* or nullptr if not found
+ */
+const Course* CourseBTree::Search(string_view courseId) const {
+	CourseKey key(courseId);
+	BTreeNode* node = root;
+	uint64_t scanned = 0;
+	STAT_ADD(searches, 1);
+
+	while (node != nullptr) {
+		bool found;
+		int i = findSlot(node, key, courseId, found);
+		++scanned;
+		if (found) {
+			STAT_ADD(searchComparisons, scanned);
+			return node->records[i];
+		}
+		node = node->leaf ? nullptr : node->children[i];
+	}
+	STAT_ADD(searchComparisons, scanned);
+	return nullptr;
+}
+
+/*
+ * Size() returns the number of courses in the tree
+ *
+ * @return size_t
+ */
+size_t CourseBTree::Size() const {
+	return courseCount;
+}
+
+/*
+ * CollectCourses() appends every course in courseId order
+ *
+ * @param vector<const Course*>& sorted
+ */
+void CourseBTree::CollectCourses(vector<const Course*>& sorted) const {
+	vector<Course*> records;
+	records.reserve(courseCount);
+	collectInOrder(root, records);
+	sorted.insert(sorted.end(), records.begin(), records.end());
+}
+
+/*
+ * Shape() counts the courses at each depth of the tree, every key of a
+ * node at the node's depth
+ *
+ * @param TreeShape& shape
+ */
+void CourseBTree::Shape(TreeShape& shape) const {
+	measureShape(root, 1, shape);
+}
+
+void CourseBTree::measureShape(const BTreeNode* node, size_t depth, TreeShape& shape) const {
+	if (node == nullptr) {
+		return;
+	}
+	shape.Add(depth, node->count);
+	if (!node->leaf) {
+		for (int i = 0; i <= node->count; ++i) {
+			measureShape(node->children[i], depth + 1, shape);
+		}
+	}
+}
+
+/*
+ * InsertCourse() adds course, or replaces the stored course with the
+ * same ID. Full nodes are split on the way down, so the insert never
+ * has to walk back up. Refuses a course that would close a prerequisite cycle.
+ *
+ * @param Course course
+ * @return bool false if refused
+ */
+bool CourseBTree::InsertCourse(Course course) {
+	vector<string> cycle;
+	if (prerequisites.FindCycle(course, cycle)) {
+		ReportCycle(course.courseId, cycle);
+		return false;
+	}
+
+	STAT_DEPTH_BEGIN();
+	Course* existing = const_cast<Course*>(Search(course.courseId));
+	if (existing != nullptr) { //Course ID already in tree, update it in place
+		prerequisites.Remove(*existing);
+		*existing = move(course);
+		prerequisites.Add(*existing);
+		STAT_DEPTH_END(inserts, insertDepthTotal, insertDepthMax);
+		return true;
+	}
+
+	CourseKey key(course.courseId);
+	Course* record = newRecord(move(course));
+	prerequisites.Add(*record);
+	++courseCount;
+
+	if (root == nullptr) {
+		root = newNode();
+	}
+	if (root->count == BTreeNode::MAX_KEYS) { //Full root, grow the tree by one level
+		BTreeNode* newRoot = newNode();
+		newRoot->leaf = false;
+		newRoot->children[0] = root;
+		root = newRoot;
+		splitChild(root, 0);
+	}
+	insertNonFull(root, key, record);
+	STAT_DEPTH_END(inserts, insertDepthTotal, insertDepthMax);
+	return true;
+}
+
+/*
+ * splitChild() splits the full child i of parent around its middle key,
+ * which moves up into parent
+ *
+ * @param BTreeNode* parent, int i
+ */
+void CourseBTree::splitChild(BTreeNode* parent, int i) {
+	const int t = BTREE_MIN_DEGREE;
+	BTreeNode* full = parent->children[i];
+	BTreeNode* right = newNode();
+	right->leaf = full->leaf;
+
+	//Upper t - 1 keys (and t children) move to the new right node
+	right->count = t - 1;
+	for (int j = 0; j < t - 1; ++j) {
+		right->CopySlot(j, full, j + t);
+	}
+	if (!full->leaf) {
+		for (int j = 0; j < t; ++j) {
+			right->children[j] = full->children[j + t];
+		}
+	}
+	full->count = t - 1;
+
+	//Middle key moves up between full and right
+	for (int j = parent->count; j > i; --j) {
+		parent->children[j + 1] = parent->children[j];
+	}
+	parent->children[i + 1] = right;
+	insertAt(parent, i, full->Key(t - 1), full->records[t - 1]);
+}
+
+/*
+ * insertNonFull() places key in the subtree of a node that has room
+ *
+ * @param BTreeNode* node, CourseKey key, Course* record
+ */
+void CourseBTree::insertNonFull(BTreeNode* node, const CourseKey& key, Course* record) {
+	while (true) {
+		STAT_DEPTH_STEP();
+		bool found;
+		int i = findSlot(node, key, record->courseId, found);
+		if (node->leaf) {
+			insertAt(node, i, key, record);
+			return;
+		}
+		if (node->children[i]->count == BTreeNode::MAX_KEYS) {
+			splitChild(node, i);
+			if (compare(node, i, key, record->courseId) < 0) { //Goes right of the key that moved up
+				++i;
+			}
+		}
+		node = node->children[i];
+	}
+}
+
+/*
+ * mergeSorted() puts courses (sorted, IDs unique, already in the graph)
+ * into the tree, replacing stored records with the same ID, and rebuilds
+ * it bottom up with nearly full nodes in one linear pass
+ *
+ * @param vector<Course>& courses (entries moved out)
+ */
+void CourseBTree::mergeSorted(vector<Course>& courses) {
+	vector<Course*> existing;
+	existing.reserve(courseCount);
+	collectInOrder(root, existing);
+	destroy(root);
+	root = nullptr;
+
+	vector<Course*> sorted;
+	sorted.reserve(existing.size() + courses.size());
+	size_t e = 0;
+	for (Course& aCourse : courses) {
+		while (e < existing.size() && existing[e]->courseId < aCourse.courseId) {
+			sorted.push_back(existing[e++]);
+		}
+		if (e < existing.size() && existing[e]->courseId == aCourse.courseId) {
+			*existing[e] = move(aCourse);
+			sorted.push_back(existing[e++]);
+		}
+		else {
+			sorted.push_back(newRecord(move(aCourse)));
+		}
+	}
+	while (e < existing.size()) {
+		sorted.push_back(existing[e++]);
+	}
+	courseCount = sorted.size();
+	buildFromSorted(sorted);
+}
+
+/*
+ * buildFromSorted() builds the tree (which must be empty) over the sorted
+ * records bottom up with nearly full nodes in one linear pass
+ *
+ * @param vector<Course*>& sorted
+ */
+void CourseBTree::buildFromSorted(const vector<Course*>& sorted) {
+	if (sorted.empty()) {
+		return;
+	}
+
+	/*
+	 * Build the leaves: L leaves hold all but L - 1 of the records, and the
+	 * L - 1 records between them become separators for the level above.
+	 * L = ceil((n + 1) / (MAX_KEYS + 1)) keeps every leaf at least half full.
+	 */
+	const size_t maxKeys = BTreeNode::MAX_KEYS;
+	size_t n = sorted.size();
+	size_t leafCount = (n <= maxKeys) ? 1 : (n + 1 + maxKeys) / (maxKeys + 1);
+	size_t leafKeys = n - (leafCount - 1);
+
+	vector<BTreeNode*> level;
+	vector<Course*> separators;
+	size_t next = 0;
+	for (size_t l = 0; l < leafCount; ++l) {
+		size_t count = leafKeys / leafCount + (l < leafKeys % leafCount ? 1 : 0);
+		BTreeNode* leaf = newNode();
+		for (size_t j = 0; j < count; ++j, ++next) {
+			leaf->SetSlot(j, CourseKey(sorted[next]->courseId), sorted[next]);
+		}
+		leaf->count = static_cast<int>(count);
+		level.push_back(leaf);
+		if (l + 1 < leafCount) {
+			separators.push_back(sorted[next++]);
+		}
+	}
+
+	//Group each level's nodes under parents of t to 2t children until one root is left
+	const size_t maxChildren = maxKeys + 1;
+	while (level.size() > 1) {
+		size_t parentCount = (level.size() + maxChildren - 1) / maxChildren;
+		vector<BTreeNode*> parents;
+		vector<Course*> upper;
+		size_t first = 0;
+		for (size_t p = 0; p < parentCount; ++p) {
+			size_t children = level.size() / parentCount + (p < level.size() % parentCount ? 1 : 0);
+			BTreeNode* parent = newNode();
+			parent->leaf = false;
+			for (size_t j = 0; j < children; ++j) {
+				parent->children[j] = level[first + j];
+				if (j + 1 < children) { //Separator between child j and j + 1
+					parent->SetSlot(j, CourseKey(separators[first + j]->courseId), separators[first + j]);
+				}
+			}
+			parent->count = static_cast<int>(children - 1);
+			parents.push_back(parent);
+			if (p + 1 < parentCount) {
+				upper.push_back(separators[first + children - 1]);
+			}
+			first += children;
+		}
+		level.swap(parents);
+		separators.swap(upper);
+	}
+	root = level[0];
+}
+
+/*
+ * collectInOrder() appends every record below node in courseId order
+ */
+void CourseBTree::collectInOrder(BTreeNode* node, vector<Course*>& sorted) const {
+	if (node == nullptr) {
+		return;
+	}
+	for (int i = 0; i < node->count; ++i) {
+		if (!node->leaf) {
+			collectInOrder(node->children[i], sorted);
+		}
+		sorted.push_back(node->records[i]);
+	}
+	if (!node->leaf) {
+		collectInOrder(node->children[node->count], sorted);
+	}
+}
+
+/*
+ * InOrder() writes every course to sink in courseId order
+ *
+ * @param OutputSink sink
+ */
+void CourseBTree::InOrder(OutputSink& sink) {
+	inOrder(root, sink);
+}
+
+void CourseBTree::inOrder(BTreeNode* node, OutputSink& sink) {
+	if (node == nullptr) {
+		return;
+	}
+	for (int i = 0; i < node->count; ++i) {
+		if (!node->leaf) {
+			inOrder(node->children[i], sink);
+		}
+		sink.Write(node->records[i]->courseId);
+		sink.Write(", ");
+		sink.Write(node->records[i]->courseName);
+		sink.Put('\n');
+	}
+	if (!node->leaf) {
+		inOrder(node->children[node->count], sink);
+	}
+}
+
+/*
+ * DeleteCourseWithDependencyCheck()
+ * Same checks and messages as the BinarySearchTree version: the course
+ * must exist and must not be a prerequisite of another course.
+ * @param string courseId
+ * @return boolean
+ */
+bool CourseBTree::DeleteCourseWithDependencyCheck(const string& courseId) {
+	Course* record = const_cast<Course*>(Search(courseId)); //Find the course to delete
+
+	//if course to delete not found
+	if (record == nullptr) {
+		cout << "Error: " << courseId << " doesn't exist." << endl;
+		return false;
+	}
+
+	//if course to delete is a dependency
+	if (prerequisites.IsPrerequisite(courseId)) {
+		cout << "Error: Can not delete " << courseId
+			<< ". It is a prerequisite to another course." << endl;
+		return false;
+	}
+
+	eraseRecord(record);
+	cout << courseId << " has been successfully deleted." << endl;
+	return true;
+}
+
+/*
+ * eraseRecord() removes record's key from the tree and frees the record
+ *
+ * @param Course* record
+ */
+void CourseBTree::eraseRecord(Course* record) {
+	STAT_DEPTH_BEGIN();
+	removeKey(root, CourseKey(record->courseId), record->courseId);
+	STAT_DEPTH_END(deletes, deleteDepthTotal, deleteDepthMax);
+	if (root->count == 0) { //Root emptied by a merge, tree shrinks by one level
+		BTreeNode* oldRoot = root;
+		root = root->leaf ? nullptr : root->children[0];
+		delete oldRoot;
+	}
+	prerequisites.Remove(*record);
+	freeRecord(record);
+	--courseCount;
+}
+
+/*
+ * eraseEach() deletes the records one at a time (a small cascade)
+ *
+ * @param vector<string>& courseIds (stored, dependents first)
+ */
+void CourseBTree::eraseEach(const vector<string>& courseIds) {
+	for (const string& courseId : courseIds) {
+		eraseRecord(const_cast<Course*>(Search(courseId)));
+	}
+}
+
+/*
+ * eraseSorted() filters the doomed records out and rebuilds the tree with
+ * buildFromSorted(), like mergeSorted()
+ *
+ * @param vector<string>& doomed (stored, sorted by courseId)
+ */
+void CourseBTree::eraseSorted(const vector<string>& doomed) {
+	vector<Course*> existing;
+	existing.reserve(courseCount);
+	collectInOrder(root, existing);
+	destroy(root);
+	root = nullptr;
+
+	vector<Course*> kept;
+	kept.reserve(existing.size() - doomed.size());
+	size_t d = 0;
+	for (Course* record : existing) {
+		if (d < doomed.size() && record->courseId == doomed[d]) {
+			++d;
+			prerequisites.Remove(*record);
+			freeRecord(record);
+		}
+		else {
+			kept.push_back(record);
+		}
+	}
+	courseCount = kept.size();
+	buildFromSorted(kept);
+}
+
+/*
+ * removeKey() deletes courseId from the subtree of node, which (unless it
+ * is the root) holds at least t keys, so a key can always be taken out.
+ * Children are topped up before descending, so no fix-up pass back up is needed.
+ *
+ * @param BTreeNode* node, CourseKey key, string_view courseId
+ */
+void CourseBTree::removeKey(BTreeNode* node, const CourseKey& key, string_view courseId) {
+	STAT_DEPTH_STEP();
+	const int t = BTREE_MIN_DEGREE;
+	bool found;
+	int i = findSlot(node, key, courseId, found);
+
+	if (found && node->leaf) { //Key in a leaf, just take it out
+		removeAt(node, i);
+		return;
+	}
+
+	if (found) { //Key in an internal node
+		BTreeNode* left = node->children[i];
+		BTreeNode* right = node->children[i + 1];
+		if (left->count >= t) { //Replace with predecessor, then delete the predecessor below
+			BTreeNode* pred = left;
+			while (!pred->leaf) {
+				pred = pred->children[pred->count];
+			}
+			node->CopySlot(i, pred, pred->count - 1);
+			removeKey(left, node->Key(i), node->records[i]->courseId);
+		}
+		else if (right->count >= t) { //Replace with successor
+			BTreeNode* succ = right;
+			while (!succ->leaf) {
+				succ = succ->children[0];
+			}
+			node->CopySlot(i, succ, 0);
+			removeKey(right, node->Key(i), node->records[i]->courseId);
+		}
+		else { //Both children minimal, merge them around the key and delete from the merge
+			mergeChildren(node, i);
+			removeKey(left, key, courseId);
+		}
+		return;
+	}
+
+	if (node->leaf) { //Not in the tree
+		return;
+	}
+
+	if (node->children[i]->count < t) { //Make sure the child can give up a key
+		fillChild(node, i);
+		if (i > node->count) { //Child i was merged into its left sibling
+			--i;
+		}
+	}
+	removeKey(node->children[i], key, courseId);
+}
+
+/*
+ * fillChild() brings child i of node up to t keys by borrowing from a
+ * sibling through the parent key, or by merging with a sibling
+ *
+ * @param BTreeNode* node, int i
+ */
+void CourseBTree::fillChild(BTreeNode* node, int i) {
+	const int t = BTREE_MIN_DEGREE;
+	BTreeNode* child = node->children[i];
+
+	if (i > 0 && node->children[i - 1]->count >= t) { //Borrow from left sibling
+		BTreeNode* left = node->children[i - 1];
+		if (!child->leaf) {
+			for (int j = child->count; j >= 0; --j) {
+				child->children[j + 1] = child->children[j];
+			}
+			child->children[0] = left->children[left->count];
+		}
+		insertAt(child, 0, node->Key(i - 1), node->records[i - 1]);
+		node->CopySlot(i - 1, left, left->count - 1);
+		--left->count;
+	}
+	else if (i < node->count && node->children[i + 1]->count >= t) { //Borrow from right sibling
+		BTreeNode* right = node->children[i + 1];
+		insertAt(child, child->count, node->Key(i), node->records[i]);
+		if (!child->leaf) {
+			child->children[child->count] = right->children[0];
+			for (int j = 0; j < right->count; ++j) {
+				right->children[j] = right->children[j + 1];
+			}
+		}
+		node->CopySlot(i, right, 0);
+		removeAt(right, 0);
+	}
+	else if (i < node->count) { //Merge with right sibling
+		mergeChildren(node, i);
+	}
+	else { //Last child, merge with left sibling
+		mergeChildren(node, i - 1);
+	}
+}
+
+/*
+ * mergeChildren() joins child i + 1 and key i of node into child i
+ *
+ * @param BTreeNode* node, int i
+ */
+void CourseBTree::mergeChildren(BTreeNode* node, int i) {
+	BTreeNode* left = node->children[i];
+	BTreeNode* right = node->children[i + 1];
+
+	insertAt(left, left->count, node->Key(i), node->records[i]);
+	int base = left->count;
+	for (int j = 0; j < right->count; ++j) {
+		left->CopySlot(base + j, right, j);
+	}
+	if (!left->leaf) {
+		for (int j = 0; j <= right->count; ++j) {
+			left->children[base + j] = right->children[j];
+		}
+	}
+	left->count += right->count;
+
+	removeAt(node, i);
+	for (int j = i + 1; j <= node->count; ++j) {
+		node->children[j] = node->children[j + 1];
+	}
+	delete right;
+}
+
+/*
+ * Verify() adds the B-tree invariants to the catalog checks: every node but
+ * the root holds t - 1 to 2t - 1 keys (the root at least one), all leaves
+ * are at the same depth, each key is the packed key of its record, and the
+ * nodes hold courseCount keys in all. Key order across nodes is covered by
+ * the sorted in-order walk of CourseCatalog::Verify().
+ *
+ * @param string& problem
+ * @return bool false if an invariant is broken
+ */
+bool CourseBTree::Verify(string& problem) const {
+	if (!CourseCatalog::Verify(problem)) {
+		return false;
+	}
+	size_t leafDepth = 0;
+	size_t keys = verifyNode(root, 1, leafDepth, problem);
+	if (!problem.empty()) {
+		return false;
+	}
+	if (keys != courseCount) {
+		problem = to_string(keys) + " keys in the nodes but " + to_string(courseCount) + " courses";
+		return false;
+	}
+	return true;
+}
+
+size_t CourseBTree::verifyNode(const BTreeNode* node, size_t depth, size_t& leafDepth, string& problem) const {
+	if (node == nullptr) {
+		return 0;
+	}
+	int fewest = (node == root) ? 1 : BTREE_MIN_DEGREE - 1;
+	if (node->count < fewest || node->count > BTreeNode::MAX_KEYS) {
+		problem = "node with " + to_string(node->count) + " keys at depth " + to_string(depth);
+		return 0;
+	}
+	for (int i = 0; i < node->count; ++i) {
+		if (CompareKeys(node->Key(i), CourseKey(node->records[i]->courseId)) != 0) {
+			problem = "wrong key at " + node->records[i]->courseId;
+			return 0;
+		}
+	}
+	if (node->leaf) {
+		if (leafDepth == 0) {
+			leafDepth = depth;
+		}
+		else if (leafDepth != depth) {
+			problem = "leaves at depths " + to_string(leafDepth) + " and " + to_string(depth);
+		}
+		return node->count;
+	}
+	size_t keys = node->count;
+	for (int i = 0; i <= node->count && problem.empty(); ++i) {
+		if (node->children[i] == nullptr) {
+			problem = "missing child under " + node->records[i < node->count ? i : i - 1]->courseId;
+			return 0;
+		}
+		keys += verifyNode(node->children[i], depth + 1, leafDepth, problem);
+	}
+	return keys;
+}
+
+
+/*
+ * EpochManager implements epoch-based reclamation for the concurrent tree.
+ * A reader pins the current global epoch in a reader slot for as long as
+ * it may hold pointers into the tree (see EpochGuard). A writer that unlinks
+ * memory retires it with the epoch it was unlinked in, and Collect() frees it
+ * once every pinned reader has moved past that epoch. Readers only write
+ * their own cache line, so pinning does not contend across cores.
+ * Retire() and Collect() must only be called by one writer at a time.
+ */
+class EpochManager {
+private:
+	static const size_t READER_SLOTS = 256; //Readers pinned at the same time before Pin() has to wait
+	static const uint64_t IDLE = 0;        //Slot value when no reader holds it
+
+	struct alignas(64) ReaderSlot {
+		atomic<uint64_t> epoch{ IDLE };
+	};
+
+	struct Retired {
+		uint64_t epoch;
+		void* pointer;
+		void (*destroy)(void*);
+	};
+
+	atomic<uint64_t> globalEpoch{ 1 };
+	ReaderSlot slots[READER_SLOTS];
+	vector<Retired> retired; //Unlinked memory waiting for old readers to finish
+
+	uint64_t oldestPinned() const;
+
+public:
+	EpochManager() {}
+	~EpochManager();
+	EpochManager(const EpochManager&) = delete;
+	EpochManager& operator=(const EpochManager&) = delete;
+
+	size_t Pin();
+	void Unpin(size_t slot);
+	void Retire(void* pointer, void (*destroy)(void*));
+	void Collect();
+
+	template <typename T>
+	void Retire(T* pointer) {
+		Retire(pointer, [](void* object) { delete static_cast<T*>(object); });
+	}
+};
+
+/*
+ * Destructor frees everything still retired. No reader may be pinned.
+ */
+EpochManager::~EpochManager() {
+	for (const Retired& entry : retired) {
+		entry.destroy(entry.pointer);
+	}
+}
+
+/*
+ * Pin() claims a free reader slot and announces the current epoch in it.
+ * Each thread starts at its own slot, so threads normally claim different
+ * cache lines. The claim is sequentially consistent, so the tree root read
+ * after it is at least as new as any retire the writer has not yet collected.
+ *
+ * @return size_t slot to pass to Unpin()
+ */
+size_t EpochManager::Pin() {
+	static thread_local size_t hint = hash<thread::id>()(this_thread::get_id()) % READER_SLOTS;
+
+	while (true) {
+		for (size_t i = 0; i < READER_SLOTS; ++i) {
+			size_t slot = (hint + i) % READER_SLOTS;
+			uint64_t expected = IDLE;
+			if (slots[slot].epoch.load(memory_order_relaxed) == IDLE
+				&& slots[slot].epoch.compare_exchange_strong(expected, globalEpoch.load())) {
+				hint = slot;
+				return slot;
+			}
+		}
+		this_thread::yield(); //Every slot taken, wait for a reader to finish
+	}
+}
+
+/*
+ * Unpin() releases the slot, after which the reader may not use any
+ * pointer it read from the tree
+ *
+ * @param size_t slot
+ */
+void EpochManager::Unpin(size_t slot) {
+	slots[slot].epoch.store(IDLE, memory_order_release);
+}
+
+/*
+ * Retire() hands over memory the writer has just unlinked from the tree,
+ * to be freed by a later Collect()
+ *
+ * @param void* pointer, destroy (frees pointer)
+ */
+void EpochManager::Retire(void* pointer, void (*destroy)(void*)) {
+	retired.push_back({ globalEpoch.load(), pointer, destroy });
+}
+
+/*
+ * oldestPinned() returns the oldest epoch a reader is pinned at,
+ * or the current epoch if no reader is pinned
+ *
+ * @return uint64_t
+ */
+uint64_t EpochManager::oldestPinned() const {
+	uint64_t oldest = globalEpoch.load();
+	for (const ReaderSlot& slot : slots) {
+		uint64_t epoch = slot.epoch.load();
+		if (epoch != IDLE && epoch < oldest) {
+			oldest = epoch;
+		}
+	}
+	return oldest;
+}
+
+/*
+ * Collect() starts a new epoch, then frees every retired pointer that was
+ * unlinked before the oldest pinned reader started. Called by the writer
+ * after each change, so retired memory is freed after at most one more write.
+ */
+void EpochManager::Collect() {
+	globalEpoch.fetch_add(1);
+	uint64_t oldest = oldestPinned();
+
+	size_t kept = 0;
+	for (size_t i = 0; i < retired.size(); ++i) {
+		if (retired[i].epoch < oldest) { //No pinned reader can still reach it
+			retired[i].destroy(retired[i].pointer);
+		}
+		else {
+			retired[kept++] = retired[i];
+		}
+	}
+	retired.resize(kept);
+}
+
+/*
+ * EpochGuard pins the calling thread for its lifetime. Pointers read from a
+ * ConcurrentCourseTree under a guard (e.g. by Search(courseId, guard)) stay
+ * valid until that guard is destroyed. Guards can be nested.
+ */
+class EpochGuard {
+private:
+	EpochManager& epochs;
+	size_t slot;
+
+public:
+	explicit EpochGuard(EpochManager& manager) : epochs(manager) {
+		slot = epochs.Pin();
+	}
+	~EpochGuard() {
+		epochs.Unpin(slot);
+	}
+	EpochGuard(const EpochGuard&) = delete;
+	EpochGuard& operator=(const EpochGuard&) = delete;
+};
+
+
+/*
+ * PathCopyingTree is the AVL core ConcurrentCourseTree and
+ * PersistentCourseTree share. A node is never changed once built: a change
+ * copies the root-to-node path (and any node a rotation touches), shares
+ * every other subtree with the previous version and hands the new root to
+ * publish(). Loads and large cascades build a new balanced tree instead.
+ * Reclaim is the node and reclaim policy, what the trees differ in:
+ *   Node, Record         node type and stored course type
+ *   CourseOf(record)     the course a record holds
+ *   NewRecord(course)    stores a course
+ *   NewNode(...)         builds a node, taking over left and right
+ *   Share(node)          a new node points at node as well
+ *   Unlink(node)         node, of the version being replaced, was copied
+ *   Release(node)        drops the writer's own reference to a subtree
+ *   UnlinkRecord(record) the course left the current version
+ *   UnlinkTree(node)     every node of the version was replaced
+ * Helpers return a subtree the caller owns and only borrow node. Writers
+ * are serialized by writer, and the prerequisite graph belongs to them.
+ */
+template <class Reclaim>
+class PathCopyingTree : public CourseCatalog {
+protected:
+	using Node = typename Reclaim::Node;
+	using Record = typename Reclaim::Record;
+
+	atomic<const Node*> root; //Current version
+	atomic<size_t> courseCount;
+	mutex writer; //Serializes writers, readers never take it
+	Reclaim reclaim;
+	PrerequisiteGraph prerequisites; //Only used by writers
+
+	//Path copying helpers, called with writer held
+	static int height(const Node* node) { return (node == nullptr) ? 0 : node->height; }
+	const Node* makeNode(const Node* left, const CourseKey& key, const Record* record, const Node* right);
+	const Node* balance(const Node* left, const CourseKey& key, const Record* record, const Node* right);
+	const Node* addNode(const Node* node, const CourseKey& key, const Record* record, const Record*& replaced);
+	const Node* deleteNode(const Node* node, const CourseKey& key, const string& courseId);
+	const Node* detachMin(const Node* node, const Node*& minNode);
+	const Node* buildBalanced(const vector<const Record*>& sorted, size_t first, size_t last);
+	void mergeSorted(vector<Course>& courses) override;
+	void eraseEach(const vector<string>& courseIds) override;
+	void eraseSorted(const vector<string>& doomed) override;
+	unique_lock<mutex> lockWriters() override { return unique_lock<mutex>(writer); }
+	virtual void publish(const Node* newRoot, size_t courses) = 0; //Makes newRoot (owned) the current version
+
+	const Record* searchTree(const Node* node, string_view courseId) const;
+	void collectInOrder(const Node* node, vector<const Record*>& sorted) const;
+	int verifySubtree(const Node* node, size_t& courses, string& problem) const; //Height, or -1 if broken
+
+public:
+	PathCopyingTree() : root(nullptr), courseCount(0) {}
+
+	bool InsertCourse(Course course) override;
+	size_t Size() const override { return courseCount.load(); }
+	bool DeleteCourseWithDependencyCheck(const string& courseId) override;
+	PrerequisiteGraph& Prerequisites() override { return prerequisites; } //Writer thread only
+	bool Verify(string& problem) const override;
+};
+
+/*
+ * makeNode() builds a node for record over left and right
+ *
+ * @return const Node* new node, owned by the caller
+ */
+template <class Reclaim>
+auto PathCopyingTree<Reclaim>::makeNode(const Node* left, const CourseKey& key, const Record* record, const Node* right) -> const Node* {
+	int leftHeight = height(left);
+	int rightHeight = height(right);
+	return reclaim.NewNode(left, key, record, right, 1 + (leftHeight > rightHeight ? leftHeight : rightHeight));
+}
+
+/*
+ * balance() builds the node (left, record, right) from owned subtrees,
+ * rotating it like BinarySearchTree::rebalance() when the heights differ
+ * by 2. A rotation copies the child it lifts (and the pivot of a double
+ * rotation): the grandchildren it keeps are shared before the child is
+ * unlinked and released.
+ *
+ * @param left, key, record, right
+ * @return const Node* root of the new subtree
+ */
+template <class Reclaim>
+auto PathCopyingTree<Reclaim>::balance(const Node* left, const CourseKey& key, const Record* record, const Node* right) -> const Node* {
+	int leftHeight = height(left);
+	int rightHeight = height(right);
+	const Node* result;
+
+	if (leftHeight > rightHeight + 1) { //Left heavy
+		if (height(left->left) >= height(left->right)) { //Left-Left case
+			result = makeNode(reclaim.Share(left->left), left->key, left->record,
+				makeNode(reclaim.Share(left->right), key, record, right));
+		}
+		else { //Left-Right case
+			const Node* pivot = left->right;
+			reclaim.Unlink(pivot);
+			result = makeNode(makeNode(reclaim.Share(left->left), left->key, left->record, reclaim.Share(pivot->left)),
+				pivot->key, pivot->record, makeNode(reclaim.Share(pivot->right), key, record, right));
+		}
+		reclaim.Unlink(left);
+		reclaim.Release(left);
+		return result;
+	}
+	if (rightHeight > leftHeight + 1) { //Right heavy
+		if (height(right->right) >= height(right->left)) { //Right-Right case
+			result = makeNode(makeNode(left, key, record, reclaim.Share(right->left)), right->key, right->record,
+				reclaim.Share(right->right));
+		}
+		else { //Right-Left case
+			const Node* pivot = right->left;
+			reclaim.Unlink(pivot);
+			result = makeNode(makeNode(left, key, record, reclaim.Share(pivot->left)), pivot->key, pivot->record,
+				makeNode(reclaim.Share(pivot->right), right->key, right->record, reclaim.Share(right->right)));
+		}
+		reclaim.Unlink(right);
+		reclaim.Release(right);
+		return result;
+	}
+	return makeNode(left, key, record, right); //already balanced
+}
+
+/*
+ * InsertCourse() adds course, or replaces the stored course with the same ID,
+ * in a new version of the tree. Costs O(log n) new nodes.
+ * Refuses a course that would close a prerequisite cycle.
+ *
+ * @param Course course
+ * @return bool false if refused
+ */
+template <class Reclaim>
+bool PathCopyingTree<Reclaim>::InsertCourse(Course course) {
+	lock_guard<mutex> lock(writer);
+	vector<string> cycle;
+	if (prerequisites.FindCycle(course, cycle)) {
+		ReportCycle(course.courseId, cycle);
+		return false;
+	}
+
+	CourseKey key(course.courseId);
+	const Record* record = reclaim.NewRecord(move(course));
+	const Record* replaced = nullptr;
+	STAT_DEPTH_BEGIN();
+	const Node* newRoot = addNode(root.load(), key, record, replaced);
+	STAT_DEPTH_END(inserts, insertDepthTotal, insertDepthMax);
+
+	if (replaced != nullptr) { //Course ID already in tree
+		prerequisites.Remove(Reclaim::CourseOf(replaced));
+		reclaim.UnlinkRecord(replaced);
+	}
+	prerequisites.Add(Reclaim::CourseOf(record));
+	publish(newRoot, courseCount.load() + (replaced == nullptr ? 1 : 0));
+	return true;
+}
+
+/*
+ * addNode() returns a copy of the subtree with record added. Every node on
+ * the path is copied; subtrees off the path are shared.
+ *
+ * @param node, key, record, replaced (set to the old course if the ID existed)
+ * @return const Node* new subtree root
+ */
+template <class Reclaim>
+auto PathCopyingTree<Reclaim>::addNode(const Node* node, const CourseKey& key, const Record* record,
+	const Record*& replaced) -> const Node* {
+	if (node == nullptr) {
+		return makeNode(nullptr, key, record, nullptr);
+	}
+	STAT_DEPTH_STEP();
+	reclaim.Unlink(node);
+
+	int comparison = CompareCourseIds(key, Reclaim::CourseOf(record).courseId, node->key, Reclaim::CourseOf(node->record).courseId);
+	if (comparison < 0) {
+		return balance(addNode(node->left, key, record, replaced), node->key, node->record, reclaim.Share(node->right));
+	}
+	if (comparison > 0) {
+		return balance(reclaim.Share(node->left), node->key, node->record, addNode(node->right, key, record, replaced));
+	}
+	replaced = node->record; //Same ID, shape unchanged
+	return makeNode(reclaim.Share(node->left), key, record, reclaim.Share(node->right));
+}
+
+/*
+ * mergeSorted() puts courses (sorted, IDs unique, already in the graph)
+ * into one new balanced version, unlinking the courses they replace and
+ * the old version's nodes. Called with writer held.
+ *
+ * @param vector<Course>& courses (entries moved out)
+ */
+template <class Reclaim>
+void PathCopyingTree<Reclaim>::mergeSorted(vector<Course>& courses) {
+	const Node* oldRoot = root.load();
+	vector<const Record*> existing;
+	existing.reserve(courseCount.load());
+	collectInOrder(oldRoot, existing);
+
+	vector<const Record*> sorted;
+	sorted.reserve(existing.size() + courses.size());
+	size_t e = 0;
+	for (Course& aCourse : courses) {
+		while (e < existing.size() && Reclaim::CourseOf(existing[e]).courseId < aCourse.courseId) {
+			sorted.push_back(existing[e++]);
+		}
+		if (e < existing.size() && Reclaim::CourseOf(existing[e]).courseId == aCourse.courseId) {
+			reclaim.UnlinkRecord(existing[e++]);
+		}
+		sorted.push_back(reclaim.NewRecord(move(aCourse)));
+	}
+	while (e < existing.size()) {
+		sorted.push_back(existing[e++]);
+	}
+
+	reclaim.UnlinkTree(oldRoot);
+	publish(buildBalanced(sorted, 0, sorted.size()), sorted.size());
+}
+
+/*
+ * buildBalanced() builds a height balanced subtree over sorted[first, last)
+ *
+ * @param sorted, size_t first, size_t last
+ * @return const Node* subtree root
+ */
+template <class Reclaim>
+auto PathCopyingTree<Reclaim>::buildBalanced(const vector<const Record*>& sorted, size_t first, size_t last) -> const Node* {
+	if (first >= last) {
+		return nullptr;
+	}
+	size_t middle = first + (last - first) / 2;
+	const Node* left = buildBalanced(sorted, first, middle);
+	const Node* right = buildBalanced(sorted, middle + 1, last);
+	return makeNode(left, CourseKey(Reclaim::CourseOf(sorted[middle]).courseId), sorted[middle], right);
+}
+
+template <class Reclaim>
+auto PathCopyingTree<Reclaim>::searchTree(const Node* node, string_view courseId) const -> const Record* {
+	CourseKey key(courseId);
+	uint64_t comparisons = 0;
+	while (node != nullptr) {
+		int comparison = CompareKeys(node->key, key);
+		if (comparison == 0) { //Keys tie, long IDs may still differ
+			comparison = CompareCourseIds(node->key, Reclaim::CourseOf(node->record).courseId, key, courseId);
+		}
+		++comparisons;
+		if (comparison == 0) {
+			STAT_ADD(searchComparisons, comparisons);
+			return node->record;
+		}
+		node = (comparison > 0) ? node->left : node->right;
+	}
+	STAT_ADD(searchComparisons, comparisons);
+	return nullptr;
+}
+
+template <class Reclaim>
+void PathCopyingTree<Reclaim>::collectInOrder(const Node* node, vector<const Record*>& sorted) const {
+	if (node != nullptr) {
+		collectInOrder(node->left, sorted);
+		sorted.push_back(node->record);
+		collectInOrder(node->right, sorted);
+	}
+}
+
+/*
+ * DeleteCourseWithDependencyCheck()
+ * Same checks and messages as the BinarySearchTree version. The course
+ * is removed in a new version; readers of older versions can still see it.
+ * @param string courseId
+ * @return boolean
+ */
+template <class Reclaim>
+bool PathCopyingTree<Reclaim>::DeleteCourseWithDependencyCheck(const string& courseId) {
+	lock_guard<mutex> lock(writer);
+	const Node* oldRoot = root.load();
+	const Record* record = searchTree(oldRoot, courseId); //Find the course to delete
+
+	//if course to delete not found
+	if (record == nullptr) {
+		cout << "Error: " << courseId << " doesn't exist." << endl;
+		return false;
+	}
+
+	//if course to delete is a dependency
+	if (prerequisites.IsPrerequisite(courseId)) {
+		cout << "Error: Can not delete " << courseId
+			<< ". It is a prerequisite to another course." << endl;
+		return false;
+	}
+
+	STAT_DEPTH_BEGIN();
+	const Node* newRoot = deleteNode(oldRoot, CourseKey(courseId), courseId);
+	STAT_DEPTH_END(deletes, deleteDepthTotal, deleteDepthMax);
+	prerequisites.Remove(Reclaim::CourseOf(record));
+	reclaim.UnlinkRecord(record);
+	publish(newRoot, courseCount.load() - 1);
+	cout << courseId << " has been successfully deleted." << endl;
+	return true;
+}
+
+/*
+ * eraseEach() deletes a small cascade from a private working copy,
+ * releasing each intermediate copy as soon as the next one is built, and
+ * publishes only the result, so readers see the whole cascade at once.
+ * Called with writer held.
+ *
+ * @param vector<string>& courseIds (stored, dependents first)
+ */
+template <class Reclaim>
+void PathCopyingTree<Reclaim>::eraseEach(const vector<string>& courseIds) {
+	const Node* working = reclaim.Share(root.load());
+	for (const string& courseId : courseIds) {
+		const Record* record = searchTree(working, courseId);
+		prerequisites.Remove(Reclaim::CourseOf(record));
+		STAT_DEPTH_BEGIN();
+		const Node* next = deleteNode(working, CourseKey(courseId), courseId);
+		STAT_DEPTH_END(deletes, deleteDepthTotal, deleteDepthMax);
+		reclaim.Release(working);
+		reclaim.UnlinkRecord(record);
+		working = next;
+	}
+	publish(working, courseCount.load() - courseIds.size());
+}
+
+/*
+ * eraseSorted() publishes one new balanced version of the courses that
+ * are kept, unlinking the doomed courses and the old version's nodes.
+ * Called with writer held.
+ *
+ * @param vector<string>& doomed (stored, sorted by courseId)
+ */
+template <class Reclaim>
+void PathCopyingTree<Reclaim>::eraseSorted(const vector<string>& doomed) {
+	const Node* oldRoot = root.load();
+	vector<const Record*> existing;
+	existing.reserve(courseCount.load());
+	collectInOrder(oldRoot, existing);
+
+	vector<const Record*> kept;
+	kept.reserve(existing.size() - doomed.size());
+	size_t d = 0;
+	for (const Record* record : existing) {
+		if (d < doomed.size() && Reclaim::CourseOf(record).courseId == doomed[d]) {
+			++d;
+			prerequisites.Remove(Reclaim::CourseOf(record));
+			reclaim.UnlinkRecord(record);
+		}
+		else {
+			kept.push_back(record);
+		}
+	}
+	reclaim.UnlinkTree(oldRoot);
+	publish(buildBalanced(kept, 0, kept.size()), kept.size());
+}
+
+/*
+ * deleteNode() returns a copy of the subtree without courseId (which must
+ * be in it), copying and rebalancing the path like addNode()
+ *
+ * @param node, key, courseId
+ * @return const Node* new subtree root
+ */
+template <class Reclaim>
+auto PathCopyingTree<Reclaim>::deleteNode(const Node* node, const CourseKey& key, const string& courseId) -> const Node* {
+	STAT_DEPTH_STEP();
+	reclaim.Unlink(node);
+
+	int comparison = CompareCourseIds(key, courseId, node->key, Reclaim::CourseOf(node->record).courseId);
+	if (comparison < 0) {
+		return balance(deleteNode(node->left, key, courseId), node->key, node->record, reclaim.Share(node->right));
+	}
+	if (comparison > 0) {
+		return balance(reclaim.Share(node->left), node->key, node->record, deleteNode(node->right, key, courseId));
+	}
+
+	//Node found, one child takes its place or the successor is moved up
+	if (node->left == nullptr) {
+		return reclaim.Share(node->right);
+	}
+	if (node->right == nullptr) {
+		return reclaim.Share(node->left);
+	}
+	const Node* successor = nullptr;
+	const Node* rightSubtree = detachMin(node->right, successor);
+	return balance(reclaim.Share(node->left), successor->key, successor->record, rightSubtree);
+}
+
+/*
+ * detachMin() returns a copy of the subtree without its smallest node,
+ * which is returned in minNode (still part of the old version)
+ *
+ * @param node, minNode
+ * @return const Node* new subtree root
+ */
+template <class Reclaim>
+auto PathCopyingTree<Reclaim>::detachMin(const Node* node, const Node*& minNode) -> const Node* {
+	STAT_DEPTH_STEP();
+	reclaim.Unlink(node);
+	if (node->left == nullptr) {
+		minNode = node;
+		return reclaim.Share(node->right);
+	}
+	const Node* left = detachMin(node->left, minNode);
+	return balance(left, node->key, node->record, reclaim.Share(node->right));
+}
+
+/*
+ * Verify() adds the AVL invariants of the current version to the generic
+ * checks: stored heights match the children, sibling heights differ by at
+ * most one, each key belongs to its course and the node count is Size().
+ * Writer thread only.
+ *
+ * @param string& problem
+ * @return bool false if an invariant is broken
+ */
+template <class Reclaim>
+bool PathCopyingTree<Reclaim>::Verify(string& problem) const {
+	size_t courses = 0;
+	if (!CourseCatalog::Verify(problem) || verifySubtree(root.load(), courses, problem) < 0) {
+		return false;
+	}
+	if (courses != courseCount.load()) {
+		problem = to_string(courses) + " nodes but " + to_string(courseCount.load()) + " courses";
+		return false;
+	}
+	return true;
+}
+
+template <class Reclaim>
+int PathCopyingTree<Reclaim>::verifySubtree(const Node* node, size_t& courses, string& problem) const {
+	if (node == nullptr) {
+		return 0;
+	}
+	int leftHeight = verifySubtree(node->left, courses, problem);
+	int rightHeight = leftHeight < 0 ? -1 : verifySubtree(node->right, courses, problem);
+	if (rightHeight < 0) {
+		return -1;
+	}
+	const string& courseId = Reclaim::CourseOf(node->record).courseId;
+	if (leftHeight - rightHeight > 1 || rightHeight - leftHeight > 1) {
+		problem = "unbalanced at " + courseId;
+		return -1;
+	}
+	if (node->height != 1 + max(leftHeight, rightHeight)) {
+		problem = "stale height at " + courseId;
+		return -1;
+	}
+	if (CompareKeys(node->key, CourseKey(courseId)) != 0) {
+		problem = "wrong key at " + courseId;
+		return -1;
+	}
+	++courses;
+	return node->height;
+}
+
+
+//Structure declaration for a node of the concurrent tree, never changed once published
+struct ConcurrentNode {
+	CourseKey key;
+	const ConcurrentNode* left;
+	const ConcurrentNode* right;
+	int height;
+	const Course* record; //Shared by every copy of the node
+};
+
+/*
+ * EpochReclaim is the PathCopyingTree policy of ConcurrentCourseTree:
+ * nodes point straight at their course, and a node or course the new
+ * version no longer uses is retired to the EpochManager, to be freed once
+ * no reader can still be walking the version that had it.
+ */
+class EpochReclaim {
+public:
+	using Node = ConcurrentNode;
+	using Record = Course;
+
+	mutable EpochManager epochs;
+
+	static const Course& CourseOf(const Course* record) { return *record; }
+	static const Course* NewRecord(Course&& course) {
+		STAT_ADD(allocations, 1);
+		STAT_ADD(allocatedBytes, sizeof(Course));
+		return new Course(move(course));
+	}
+	static const ConcurrentNode* NewNode(const ConcurrentNode* left, const CourseKey& key, const Course* record,
+		const ConcurrentNode* right, int height) {
+		STAT_ADD(allocations, 1);
+		STAT_ADD(allocatedBytes, sizeof(ConcurrentNode));
+		return new ConcurrentNode{ key, left, right, height, record };
+	}
+	static const ConcurrentNode* Share(const ConcurrentNode* node) { return node; }
+	void Unlink(const ConcurrentNode* node) { epochs.Retire(const_cast<ConcurrentNode*>(node)); }
+	static void Release(const ConcurrentNode*) {} //The writer holds no references
+	void UnlinkRecord(const Course* record) { epochs.Retire(const_cast<Course*>(record)); }
+	void UnlinkTree(const ConcurrentNode* node);
+};
+
+/*
+ * UnlinkTree() retires every node of a version that is replaced as a whole
+ * (the courses stay, or are retired by the caller)
+ *
+ * @param const ConcurrentNode* node
+ */
+void EpochReclaim::UnlinkTree(const ConcurrentNode* node) {
+	vector<const ConcurrentNode*> pending;
+	if (node != nullptr) {
+		pending.push_back(node);
+	}
+	while (!pending.empty()) {
+		node = pending.back();
+		pending.pop_back();
+		if (node->left != nullptr) {
+			pending.push_back(node->left);
+		}
+		if (node->right != nullptr) {
+			pending.push_back(node->right);
+		}
+		Unlink(node);
+	}
+}
+
+/*
+ * ConcurrentCourseTree is the AVL tree for concurrent use: any number of
+ * threads can call Search(), InOrder() and CollectCourses() while one writer
+ * at a time runs InsertCourse(), BulkLoad() or DeleteCourseWithDependencyCheck().
+ * Readers never take a lock. Writers never change a published node; they copy
+ * the root-to-node path (and any node a rotation touches) through the
+ * PathCopyingTree core, then publish the new root with one atomic store.
+ * A reader therefore always walks one complete version of the tree.
+ * Replaced nodes and removed courses are retired to the EpochManager and
+ * freed after the readers that could see them are done.
+ * A reader thread holds an EpochGuard on Epochs() and calls
+ * Search(courseId, guard), so the courses it gets outlive later writes.
+ * The prerequisite graph is not synchronized (its queries fill caches),
+ * so Prerequisites() belongs to the writer thread like InsertCourse().
+ * Selected at startup with --concurrent.
+ */
+class ConcurrentCourseTree : public PathCopyingTree<EpochReclaim> {
+private:
+	void publish(const ConcurrentNode* newRoot, size_t courses) override;
+
+	void inOrder(const ConcurrentNode* node, OutputSink& sink);
+	void measureShape(const ConcurrentNode* node, size_t depth, TreeShape& shape) const;
+	void destroy(const ConcurrentNode* node);
+
+public:
+	ConcurrentCourseTree() {}
+	~ConcurrentCourseTree();
+	ConcurrentCourseTree(const ConcurrentCourseTree&) = delete;
+	ConcurrentCourseTree& operator=(const ConcurrentCourseTree&) = delete;
+
+	void InOrder(OutputSink& sink) override;
+	const Course* Search(string_view courseId) const override;
+	const Course* Search(string_view courseId, const EpochGuard& guard) const; //For reader threads
+	void CollectCourses(vector<const Course*>& sorted) const override;
+	void Shape(TreeShape& shape) const override;
+	EpochManager& Epochs() const { return reclaim.epochs; } //For the EpochGuard of a reader thread
+};
+
+/*
+ * Destructor frees the current version. Older versions were retired and
+ * are freed by the EpochManager. No reader may still be running.
+ */
+ConcurrentCourseTree::~ConcurrentCourseTree() {
+	destroy(root.load());
+}
+
+/*
+ * destroy() frees every node and course of the current version
+ *
+ * @param const ConcurrentNode* node
+ */
+void ConcurrentCourseTree::destroy(const ConcurrentNode* node) {
+	if (node != nullptr) {
+		destroy(node->left);
+		destroy(node->right);
+		delete node->record;
+		delete node;
+	}
+}
+
+/*
+ * publish() makes newRoot the version readers see, then lets the
+ * EpochManager free whatever old readers have stopped using
+ *
+ * @param const ConcurrentNode* newRoot, size_t courses
+ */
+void ConcurrentCourseTree::publish(const ConcurrentNode* newRoot, size_t courses) {
+	courseCount.store(courses);
+	root.store(newRoot);
+	reclaim.epochs.Collect();
+}
+
+/*
+ * Search() finds courseId in the current version without taking a lock.
+ * This CourseCatalog version is for the writer thread: the course is
+ * unpinned when it returns, so it is only safe to use until the next
+ * change to the tree. Other threads pass their guard instead.
+ *
+ * @param string_view courseId
+ * @return const Course* or nullptr if not found
+ */
+const Course* ConcurrentCourseTree::Search(string_view courseId) const {
+	EpochGuard guard(reclaim.epochs);
+	return Search(courseId, guard);
+}
+
+/*
+ * Search() for reader threads: guard pins the reader (it must be a guard
+ * on Epochs()), so the course stays valid until guard is destroyed, however
+ * many writes happen meanwhile
+ *
+ * @param string_view courseId, EpochGuard guard
+ * @return const Course* or nullptr if not found
+ */
+const Course* ConcurrentCourseTree::Search(string_view courseId, [[maybe_unused]] const EpochGuard& guard) const {
+	STAT_ADD(searches, 1);
+	return searchTree(root.load(), courseId);
+}
+
+/*
+ * InOrder() writes one consistent version of the tree to sink, even while
+ * writers publish newer ones
+ *
+ * @param OutputSink sink
+ */
+void ConcurrentCourseTree::InOrder(OutputSink& sink) {
+	EpochGuard guard(reclaim.epochs);
+	inOrder(root.load(), sink);
+}
+
+void ConcurrentCourseTree::inOrder(const ConcurrentNode* node, OutputSink& sink) {
+	if (node != nullptr) {
+		inOrder(node->left, sink);
+		sink.Write(node->record->courseId);
+		sink.Write(", ");
+		sink.Write(node->record->courseName);
+		sink.Put('\n');
+		inOrder(node->right, sink);
+	}
+}
+
+/*
+ * CollectCourses() appends every course of the current version in courseId
+ * order. Same pointer lifetime as the writer's Search().
+ *
+ * @param vector<const Course*>& sorted
+ */
+void ConcurrentCourseTree::CollectCourses(vector<const Course*>& sorted) const {
+	EpochGuard guard(reclaim.epochs);
+	collectInOrder(root.load(), sorted);
+}
+
+/*
+ * Shape() counts the courses at each depth of the current version
+ *
+ * @param TreeShape& shape
+ */
+void ConcurrentCourseTree::Shape(TreeShape& shape) const {
+	EpochGuard guard(reclaim.epochs);
+	measureShape(root.load(), 1, shape);
+}
+
+void ConcurrentCourseTree::measureShape(const ConcurrentNode* node, size_t depth, TreeShape& shape) const {
+	if (node != nullptr) {
+		shape.Add(depth);
+		measureShape(node->left, depth + 1, shape);
+		measureShape(node->right, depth + 1, shape);
+	}
+}
+
+
+/*
+ * SharedCourse is a course stored once and shared by every copy of the
+ * PersistentCourseTree nodes holding it. references counts those nodes.
+ */
+struct SharedCourse {
+	Course course;
+	mutable atomic<uint32_t> references;
+};
+
+//Structure declaration for a node of the persistent tree, never changed once built
+struct PersistentNode {
+	CourseKey key;
+	const PersistentNode* left;
+	const PersistentNode* right;
+	int height;
+	const SharedCourse* record;
+	mutable atomic<uint32_t> references; //Parents and version handles pointing here
+};
+
+/*
+ * RetainNode() and ReleaseNode() count a reference to a persistent node.
+ * Dropping the last reference frees the node and releases its children and
+ * its course in turn, so a version that is let go frees exactly the nodes
+ * no other version shares. Either may be called from any thread.
+ */
+inline const PersistentNode* RetainNode(const PersistentNode* node) {
+	if (node != nullptr) {
+		node->references.fetch_add(1, memory_order_relaxed);
+	}
+	return node;
+}
+
+void ReleaseNode(const PersistentNode* node) {
+	vector<const PersistentNode*> pending;
+	while (node != nullptr) {
+		if (node->references.fetch_sub(1, memory_order_acq_rel) == 1) {
+			if (node->record->references.fetch_sub(1, memory_order_acq_rel) == 1) {
+				delete node->record;
+			}
+			if (node->left != nullptr) {
+				pending.push_back(node->left);
+			}
+			if (node->right != nullptr) {
+				pending.push_back(node->right);
+			}
+			delete node;
+		}
+		if (pending.empty()) {
+			break;
+		}
+		node = pending.back();
+		pending.pop_back();
+	}
+}
+
+/*
+ * CatalogVersion is a read-only handle on one version of a
+ * PersistentCourseTree. Copying it costs one reference count, and the
+ * version (with every course in it) stays readable for as long as a
+ * handle exists, without locks, whatever writers do to the tree meanwhile.
+ * A default constructed handle is the empty catalog, version 0.
+ */
+class CatalogVersion {
+private:
+	const PersistentNode* root;
+	size_t courseCount;
+	uint64_t number;
+
+	void inOrder(const PersistentNode* node, OutputSink& sink) const;
+	void collectInOrder(const PersistentNode* node, vector<const Course*>& sorted) const;
+	void measureShape(const PersistentNode* node, size_t depth, TreeShape& shape) const;
+
+public:
+	CatalogVersion() : root(nullptr), courseCount(0), number(0) {}
+	CatalogVersion(const PersistentNode* root, size_t courseCount, uint64_t number); //Adopts one reference to root
+	CatalogVersion(const CatalogVersion& other);
+	CatalogVersion(CatalogVersion&& other) noexcept;
+	CatalogVersion& operator=(CatalogVersion other);
+	~CatalogVersion();
+
+	uint64_t Number() const { return number; }
+	size_t Size() const { return courseCount; }
+	const PersistentNode* Root() const { return root; }
+	const Course* Search(string_view courseId) const; //Valid while this handle exists
+	void InOrder(OutputSink& sink) const;
+	void CollectCourses(vector<const Course*>& sorted) const;
+	void Shape(TreeShape& shape) const;
+};
+
+CatalogVersion::CatalogVersion(const PersistentNode* root, size_t courseCount, uint64_t number)
+	: root(root), courseCount(courseCount), number(number) {
+}
+
+CatalogVersion::CatalogVersion(const CatalogVersion& other)
+	: root(RetainNode(other.root)), courseCount(other.courseCount), number(other.number) {
+}
+
+CatalogVersion::CatalogVersion(CatalogVersion&& other) noexcept
+	: root(other.root), courseCount(other.courseCount), number(other.number) {
+	other.root = nullptr;
+}
+
+CatalogVersion& CatalogVersion::operator=(CatalogVersion other) {
+	swap(root, other.root);
+	courseCount = other.courseCount;
+	number = other.number;
+	return *this; //other releases the version this handle held
+}
+
+CatalogVersion::~CatalogVersion() {
+	ReleaseNode(root);
+}
+
+/*
+ * Search() finds courseId in this version
+ *
+ * @param string_view courseId
+ * @return const Course* or nullptr if not found
+ */
+const Course* CatalogVersion::Search(string_view courseId) const {
+	CourseKey key(courseId);
+	uint64_t comparisons = 0;
+	STAT_ADD(searches, 1);
+	const PersistentNode* node = root;
+	while (node != nullptr) {
+		int comparison = CompareKeys(node->key, key);
+		if (comparison == 0) { //Keys tie, long IDs may still differ
+			comparison = CompareCourseIds(node->key, node->record->course.courseId, key, courseId);
+		}
+		++comparisons;
+		if (comparison == 0) {
+			STAT_ADD(searchComparisons, comparisons);
+			return &node->record->course;
+		}
+		node = (comparison > 0) ? node->left : node->right;
+	}
+	STAT_ADD(searchComparisons, comparisons);
+	return nullptr;
+}
+
+/*
+ * InOrder() writes every course of this version to sink in courseId order
+ *
+ * @param OutputSink sink
+ */
+void CatalogVersion::InOrder(OutputSink& sink) const {
+	inOrder(root, sink);
+}
+
+void CatalogVersion::inOrder(const PersistentNode* node, OutputSink& sink) const {
+	if (node != nullptr) {
+		inOrder(node->left, sink);
+		sink.Write(node->record->course.courseId);
+		sink.Write(", ");
+		sink.Write(node->record->course.courseName);
+		sink.Put('\n');
+		inOrder(node->right, sink);
+	}
+}
+
+/*
+ * CollectCourses() appends every course of this version in courseId order
+ *
+ * @param vector<const Course*>& sorted
+ */
+void CatalogVersion::CollectCourses(vector<const Course*>& sorted) const {
+	collectInOrder(root, sorted);
+}
+
+void CatalogVersion::collectInOrder(const PersistentNode* node, vector<const Course*>& sorted) const {
+	if (node != nullptr) {
+		collectInOrder(node->left, sorted);
+		sorted.push_back(&node->record->course);
+		collectInOrder(node->right, sorted);
+	}
+}
+
+/*
+ * Shape() counts the courses at each depth of this version
+ *
+ * @param TreeShape& shape
+ */
+void CatalogVersion::Shape(TreeShape& shape) const {
+	measureShape(root, 1, shape);
+}
+
+void CatalogVersion::measureShape(const PersistentNode* node, size_t depth, TreeShape& shape) const {
+	if (node != nullptr) {
+		shape.Add(depth);
+		measureShape(node->left, depth + 1, shape);
+		measureShape(node->right, depth + 1, shape);
+	}
+}
+
+const size_t VERSION_HISTORY = 64; //Versions a PersistentCourseTree keeps for Version() lookups
+
+/*
+ * CountedReclaim is the PathCopyingTree policy of PersistentCourseTree:
+ * nodes and courses are reference counted, so nothing is unlinked
+ * explicitly. A node or course is freed by the release that drops its
+ * last reference, once no kept version contains it.
+ */
+class CountedReclaim {
+public:
+	using Node = PersistentNode;
+	using Record = SharedCourse;
+
+	static const Course& CourseOf(const SharedCourse* record) { return record->course; }
+	static const SharedCourse* NewRecord(Course&& course) { //No references until a node holds it
+		STAT_ADD(allocations, 1);
+		STAT_ADD(allocatedBytes, sizeof(SharedCourse));
+		return new SharedCourse{ move(course), { 0 } };
+	}
+	static const PersistentNode* NewNode(const PersistentNode* left, const CourseKey& key, const SharedCourse* record,
+		const PersistentNode* right, int height) {
+		record->references.fetch_add(1, memory_order_relaxed);
+		STAT_ADD(allocations, 1);
+		STAT_ADD(allocatedBytes, sizeof(PersistentNode));
+		return new PersistentNode{ key, left, right, height, record, { 1 } };
+	}
+	static const PersistentNode* Share(const PersistentNode* node) { return RetainNode(node); }
+	static void Unlink(const PersistentNode*) {} //Older versions may still hold it
+	static void Release(const PersistentNode* node) { ReleaseNode(node); }
+	static void UnlinkRecord(const SharedCourse*) {}
+	static void UnlinkTree(const PersistentNode*) {} //Released when its version is dropped
+};
+
+/*
+ * PersistentCourseTree is the fully persistent variant of BinarySearchTree:
+ * InsertCourse() and the deletes copy only the root-to-node path (and any
+ * node a rotation touches) through the PathCopyingTree core and share
+ * every other node with the previous version, so each change makes a new
+ * numbered version in O(log n) nodes.
+ * Snapshot() hands out the current version in O(1); a long report can walk
+ * it without locks while writers go on. Nodes and courses are reference
+ * counted and freed as soon as no kept version contains them. The last
+ * VERSION_HISTORY versions can also be looked up by number with Version().
+ * Writers are serialized like in ConcurrentCourseTree. Selected at startup
+ * with --persistent.
+ */
+class PersistentCourseTree : public PathCopyingTree<CountedReclaim> {
+private:
+	deque<CatalogVersion> history; //Kept versions, oldest first, the last is current
+	mutable mutex versionLock; //Held only to copy or push a handle in history, O(1)
+
+	void publish(const PersistentNode* newRoot, size_t courses) override;
+
+public:
+	PersistentCourseTree();
+	~PersistentCourseTree() {} //history releases every version
+	PersistentCourseTree(const PersistentCourseTree&) = delete;
+	PersistentCourseTree& operator=(const PersistentCourseTree&) = delete;
+
+	CatalogVersion Snapshot() const; //The current version, O(1)
+	bool Version(uint64_t number, CatalogVersion& version) const; //false if number is not kept
+
+	void InOrder(OutputSink& sink) override;
+	const Course* Search(string_view courseId) const override;
+	void CollectCourses(vector<const Course*>& sorted) const override;
+	void Shape(TreeShape& shape) const override;
+};
+
+PersistentCourseTree::PersistentCourseTree() {
+	history.emplace_back(); //Version 0, the empty catalog
+}
+
+/*
+ * publish() makes newRoot (whose reference it takes over) the next version
+ * and drops the oldest kept version once there are more than VERSION_HISTORY.
+ * The dropped version is released after versionLock is let go, so readers
+ * taking a snapshot never wait for nodes being freed.
+ *
+ * @param const PersistentNode* newRoot, size_t courses
+ */
+void PersistentCourseTree::publish(const PersistentNode* newRoot, size_t courses) {
+	CatalogVersion dropped;
+	{
+		lock_guard<mutex> lock(versionLock);
+		history.emplace_back(newRoot, courses, history.back().Number() + 1);
+		if (history.size() > VERSION_HISTORY) {
+			dropped = move(history.front());
+			history.pop_front();
+		}
+	}
+	root.store(newRoot, memory_order_release);
+	courseCount.store(courses);
+}
+
+/*
+ * Snapshot() returns a handle on the current version in O(1). The version
+ * stays whole and readable through the handle for as long as it is kept.
+ *
+ * @return CatalogVersion
+ */
+CatalogVersion PersistentCourseTree::Snapshot() const {
+	lock_guard<mutex> lock(versionLock);
+	return history.back();
+}
+
+/*
+ * Version() looks up a kept version by number
+ *
+ * @param uint64_t number, CatalogVersion& version
+ * @return bool false if the version is newer than the current one or was
+ *         already dropped from the history
+ */
+bool PersistentCourseTree::Version(uint64_t number, CatalogVersion& version) const {
+	lock_guard<mutex> lock(versionLock);
+	uint64_t oldest = history.front().Number();
+	if (number < oldest || number > history.back().Number()) {
+		return false;
+	}
+	version = history[number - oldest];
+	return true;
+}
+
+/*
+ * Search() finds courseId in the current version. Meant for the writer's
+ * thread, which may use the result until it next changes the tree; other
+ * threads search a Snapshot(), which keeps its courses alive.
+ *
+ * @param string_view courseId
+ * @return const Course* or nullptr if not found
+ */
+const Course* PersistentCourseTree::Search(string_view courseId) const {
+	STAT_ADD(searches, 1);
+	const SharedCourse* record = searchTree(root.load(memory_order_acquire), courseId);
+	return record == nullptr ? nullptr : &record->course;
+}
+
+/*
+ * InOrder() writes a snapshot of the catalog to sink, so a long listing
+ * holds no lock and shows one version even while writers go on
+ *
+ * @param OutputSink sink
+ */
+void PersistentCourseTree::InOrder(OutputSink& sink) {
+	Snapshot().InOrder(sink);
+}
+
+/*
+ * CollectCourses() appends every course of the current version in courseId
+ * order. Same pointer lifetime as Search().
+ *
+ * @param vector<const Course*>& sorted
+ */
+void PersistentCourseTree::CollectCourses(vector<const Course*>& sorted) const {
+	Snapshot().CollectCourses(sorted);
+}
+
+/*
+ * Shape() counts the courses at each depth of the current version
+ *
+ * @param TreeShape& shape
+ */
+void PersistentCourseTree::Shape(TreeShape& shape) const {
+	Snapshot().Shape(shape);
+}
+
+/*
+ * MappedFile maps a whole input file into memory read-only, so the parser
+ * can scan the bytes in place instead of copying them through a stream.
+ * Uses mmap() on POSIX and a file mapping on Windows. An empty file opens
+ * successfully with Size() == 0.
+ */
+class MappedFile {
+private:
+	const char* data;
+	size_t size;
+#ifdef _WIN32
+	HANDLE fileHandle;
+	HANDLE mappingHandle;
+#else
+	int fileDescriptor;
+#endif
+
+public:
+	MappedFile();
+	~MappedFile();
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	bool Open(const string& fileName);
+	void Close();
+	const char* Data() const { return data; }
+	size_t Size() const { return size; }
+};
+
+MappedFile::MappedFile() {
+	data = nullptr;
+	size = 0;
+#ifdef _WIN32
+	fileHandle = INVALID_HANDLE_VALUE;
+	mappingHandle = nullptr;
+#else
+	fileDescriptor = -1;
+#endif
+}
+
+MappedFile::~MappedFile() {
+	Close();
+}
+
+/*
+ * Open() maps fileName into memory
+ *
+ * @param string fileName
+ * @return bool true if the file is mapped (or empty)
+ */
+bool MappedFile::Open(const string& fileName) {
+	Close();
+#ifdef _WIN32
+	fileHandle = CreateFileA(fileName.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+		OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (fileHandle == INVALID_HANDLE_VALUE) {
+		return false;
+	}
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(fileHandle, &fileSize)) {
+		Close();
+		return false;
+	}
+	size = static_cast<size_t>(fileSize.QuadPart);
+	if (size == 0) { //Nothing to map
+		return true;
+	}
+	mappingHandle = CreateFileMappingA(fileHandle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (mappingHandle == nullptr) {
+		Close();
+		return false;
+	}
+	data = static_cast<const char*>(MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0));
+#else
+	fileDescriptor = open(fileName.c_str(), O_RDONLY);
+	if (fileDescriptor < 0) {
+		return false;
+	}
+	struct stat fileInfo;
+	if (fstat(fileDescriptor, &fileInfo) != 0) {
+		Close();
+		return false;
+	}
+	size = static_cast<size_t>(fileInfo.st_size);
+	if (size == 0) { //Nothing to map
+		return true;
+	}
+	void* mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fileDescriptor, 0);
+	data = (mapping == MAP_FAILED) ? nullptr : static_cast<const char*>(mapping);
+	if (data != nullptr) {
+		madvise(mapping, size, MADV_SEQUENTIAL); //parser reads front to back
+	}
+#endif
+	if (data == nullptr) {
+		Close();
+		return false;
+	}
+	return true;
+}
+
+/*
+ * Close() unmaps the file and releases its handles
+ */
+void MappedFile::Close() {
+#ifdef _WIN32
+	if (data != nullptr) {
+		UnmapViewOfFile(data);
+	}
+	if (mappingHandle != nullptr) {
+		CloseHandle(mappingHandle);
+	}
+	if (fileHandle != INVALID_HANDLE_VALUE) {
+		CloseHandle(fileHandle);
+	}
+	mappingHandle = nullptr;
+	fileHandle = INVALID_HANDLE_VALUE;
+#else
+	if (data != nullptr) {
+		munmap(const_cast<char*>(data), size);
+	}
+	if (fileDescriptor >= 0) {
+		close(fileDescriptor);
+	}
+	fileDescriptor = -1;
+#endif
+	data = nullptr;
+	size = 0;
+}
+
+/*
+ * SyncFile() flushes a file written through a stream (e.g. a snapshot) to the disk
+ *
+ * @param string fileName
+ * @return bool
+ */
+bool SyncFile(const string& fileName) {
+#ifdef _WIN32
+	int descriptor = _open(fileName.c_str(), _O_RDWR | _O_BINARY);
+	if (descriptor < 0) {
+		return false;
+	}
+	bool synced = _commit(descriptor) == 0;
+	_close(descriptor);
+#else
+	int descriptor = open(fileName.c_str(), O_RDONLY | O_CLOEXEC);
+	if (descriptor < 0) {
+		return false;
+	}
+	bool synced = fsync(descriptor) == 0;
+	close(descriptor);
+#endif
+	return synced;
+}
+
+/*
+ * ReplaceFile() renames from over to in one atomic step, so a crash leaves
+ * either the old or the new file. On POSIX the directory is synced too,
+ * so the rename itself survives a crash.
+ *
+ * @param string from, string to
+ * @return bool
+ */
+bool ReplaceFile(const string& from, const string& to) {
+#ifdef _WIN32
+	return MoveFileExA(from.c_str(), to.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+#else
+	if (rename(from.c_str(), to.c_str()) != 0) {
+		return false;
+	}
+	size_t slash = to.rfind('/');
+	string directory = slash == string::npos ? "." : slash == 0 ? "/" : to.substr(0, slash);
+	int descriptor = open(directory.c_str(), O_RDONLY | O_CLOEXEC);
+	if (descriptor >= 0) {
+		fsync(descriptor);
+		close(descriptor);
+	}
+	return true;
+#endif
+}
+
+/*
+ * FileMissing() tells a file that does not exist apart from one that can
+ * not be opened for another reason (permissions, a directory, I/O errors)
+ *
+ * @param string fileName
+ * @return bool true only if fileName does not exist
+ */
+bool FileMissing(const string& fileName) {
+#ifdef _WIN32
+	struct _stat64 fileInfo;
+	return _stat64(fileName.c_str(), &fileInfo) != 0 && errno == ENOENT;
+#else
+	struct stat fileInfo;
+	return stat(fileName.c_str(), &fileInfo) != 0 && errno == ENOENT;
+#endif
+}
+
+
+/*
+ * TemporaryFileName() returns a path in the system's temporary directory
+ * that no other process or call uses, e.g. /tmp/abcu-1234-1-benchmark.csv
+ *
+ * @param string suffix (end of the file name)
+ * @return string
+ */
+string TemporaryFileName(const string& suffix) {
+	static atomic<unsigned> calls{ 0 };
+#ifdef _WIN32
+	char directory[MAX_PATH + 1];
+	DWORD length = GetTempPathA(sizeof(directory), directory); //Ends in a backslash
+	string path = (length > 0 && length < sizeof(directory)) ? string(directory, length) : string(".\\");
+	unsigned long process = GetCurrentProcessId();
+#else
+	const char* directory = getenv("TMPDIR");
+	string path = (directory != nullptr && *directory != '\0') ? string(directory) + "/" : string("/tmp/");
+	unsigned long process = static_cast<unsigned long>(getpid());
+#endif
+	return path + "abcu-" + to_string(process) + "-" + to_string(++calls) + "-" + suffix;
+}
+
+/*
+ * CatalogSnapshot reads and writes the binary snapshot format, which lets a
+ * loaded catalog be saved once and reopened without parsing any text.
+ *
+ * Layout (native byte order, every section 8-byte aligned):
+ *   SnapshotHeader
+ *   CourseKey       keys[courseCount]     packed courseIds, sorted
+ *   SnapshotRecord  records[courseCount]  string pool offsets + prerequisite edges
+ *   char            pool[poolBytes]       every string, back to back
+ * A prerequisite inside the catalog is stored only as its edge (the index
+ * of its record); the pool holds its ID just for one outside the catalog.
+ * Pool offsets and lengths are 32-bit, so a course costs 56 bytes plus its
+ * strings and the pool is limited to 4 GB.
+ * The checksum covers everything after the header. Loading maps the file,
+ * validates it and hands the sorted courses and their prerequisite edges to
+ * CourseCatalog::LoadSorted(), so an empty catalog is built with no text
+ * parsing, sorting, ID lookups or cycle checks.
+ */
+class CatalogSnapshot {
+public:
+	static const uint32_t VERSION = 2;
+
+	struct SnapshotHeader {
+		char magic[8];        //"ABCUSNAP"
+		uint32_t version;
+		uint32_t reserved;
+		uint64_t courseCount;
+		uint64_t poolBytes;
+		uint64_t checksum;    //Checksum() of everything after the header
+	};
+
+	//A string stored in the pool
+	struct PoolString {
+		uint32_t offset;
+		uint32_t length;
+	};
+
+	struct SnapshotRecord {
+		PoolString courseId;
+		PoolString courseName;
+		PoolString preReq1;   //Empty unless preReq1Index is -1
+		PoolString preReq2;
+		int32_t preReq1Index; //Record index of preReq1, -1 if none or not in the catalog
+		int32_t preReq2Index;
+	};
+
+	static bool IsSnapshot(const char* data, size_t size);
+	static bool Save(const CourseCatalog& catalog, const string& fileName);
+	static bool Load(const char* data, size_t size, vector<Course>& courses, vector<int64_t>& preReqIndex);
+	static uint64_t Checksum(const char* data, size_t size); //Also identifies the base of an operation log
+
+private:
+	static const char MAGIC[8];
+};
+
+const char CatalogSnapshot::MAGIC[8] = { 'A', 'B', 'C', 'U', 'S', 'N', 'A', 'P' };
+
+/*
+ * Checksum() is a 64-bit multiply-xorshift hash taken a word at a time,
+ * fast enough to verify a large snapshot at memory speed. A multiply only
+ * carries a changed bit upward, so each step shifts the high half back
+ * down: every input bit reaches every output bit, and two changes in
+ * different words can not cancel out. The tail bytes and the length are
+ * mixed in last.
+ *
+ * @param data, size
+ * @return uint64_t
+ */
+uint64_t CatalogSnapshot::Checksum(const char* data, size_t size) {
+	const uint64_t multiplier = 0x9e3779b97f4a7c15ULL;
+	uint64_t hash = 0xcbf29ce484222325ULL;
+	auto mix = [&hash, multiplier](uint64_t word) {
+		hash = (hash ^ word) * multiplier;
+		hash ^= hash >> 32;
+	};
+	size_t i = 0;
+	for (; i + 8 <= size; i += 8) {
+		uint64_t word;
+		memcpy(&word, data + i, 8);
+		mix(word);
+	}
+	uint64_t tail = 0;
+	if (i < size) {
+		memcpy(&tail, data + i, size - i);
+	}
+	mix(tail);
+	mix(size);
+	return hash;
+}
+
+/*
+ * IsSnapshot() tells a snapshot file apart from a CSV by its magic bytes
+ *
+ * @param data, size (mapped file)
+ * @return bool
+ */
+bool CatalogSnapshot::IsSnapshot(const char* data, size_t size) {
+	return size >= sizeof(SnapshotHeader) && memcmp(data, MAGIC, sizeof(MAGIC)) == 0;
+}
+
+/*
+ * Save() writes every course of catalog to fileName as a snapshot. It is
+ * written and synced under a temporary name first, then renamed over
+ * fileName, so a crash leaves either the old snapshot or the new one.
+ *
+ * @param CourseCatalog catalog, string fileName
+ * @return bool true if the file was written and is on disk
+ */
+bool CatalogSnapshot::Save(const CourseCatalog& catalog, const string& fileName) {
+	vector<const Course*> sorted;
+	catalog.CollectCourses(sorted);
+
+	if (sorted.size() > static_cast<size_t>(INT32_MAX)) { //Edges are 32-bit
+		return false;
+	}
+
+	//Record index of each course, to turn prerequisite IDs into edges
+	unordered_map<string_view, int32_t> indexOf;
+	indexOf.reserve(sorted.size());
+	for (size_t i = 0; i < sorted.size(); ++i) {
+		indexOf[sorted[i]->courseId] = static_cast<int32_t>(i);
+	}
+
+	vector<CourseKey> keys;
+	vector<SnapshotRecord> records;
+	string pool;
+	keys.reserve(sorted.size());
+	records.reserve(sorted.size());
+
+	auto addString = [&pool](const string& value) {
+		PoolString stored = { static_cast<uint32_t>(pool.size()), static_cast<uint32_t>(value.size()) };
+		pool += value;
+		return stored;
+	};
+	auto edgeTo = [&indexOf](const string& preReq) {
+		auto entry = preReq.empty() ? indexOf.end() : indexOf.find(preReq);
+		return entry == indexOf.end() ? int32_t(-1) : entry->second;
+	};
+
+	for (const Course* course : sorted) {
+		keys.push_back(CourseKey(course->courseId));
+		SnapshotRecord record;
+		record.courseId = addString(course->courseId);
+		record.courseName = addString(course->courseName);
+		record.preReq1Index = edgeTo(course->preReq1);
+		record.preReq2Index = edgeTo(course->preReq2);
+		record.preReq1 = record.preReq1Index < 0 ? addString(course->preReq1) : PoolString{ 0, 0 };
+		record.preReq2 = record.preReq2Index < 0 ? addString(course->preReq2) : PoolString{ 0, 0 };
+		records.push_back(record);
+		if (pool.size() > UINT32_MAX - 7) { //Offsets are 32-bit
+			return false;
+		}
+	}
+	pool.resize((pool.size() + 7) & ~size_t(7), '\0'); //Pad the pool to a whole word
+
+	//Body is laid out exactly as it will be on disk, so it can be checksummed in one pass
+	size_t keyBytes = keys.size() * sizeof(CourseKey);
+	size_t recordBytes = records.size() * sizeof(SnapshotRecord);
+	vector<char> body(keyBytes + recordBytes + pool.size());
+	if (!keys.empty()) {
+		memcpy(body.data(), keys.data(), keyBytes);
+		memcpy(body.data() + keyBytes, records.data(), recordBytes);
+	}
+	if (!pool.empty()) {
+		memcpy(body.data() + keyBytes + recordBytes, pool.data(), pool.size());
+	}
+
+	SnapshotHeader header;
+	memcpy(header.magic, MAGIC, sizeof(MAGIC));
+	header.version = VERSION;
+	header.reserved = 0;
+	header.courseCount = sorted.size();
+	header.poolBytes = pool.size();
+	header.checksum = Checksum(body.data(), body.size());
+
+	string temporary = fileName + ".tmp";
+	ofstream outputFile(temporary, ios::binary | ios::trunc);
+	outputFile.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	outputFile.write(body.data(), body.size());
+	outputFile.close();
+	if (outputFile.fail() || !SyncFile(temporary) || !ReplaceFile(temporary, fileName)) {
+		remove(temporary.c_str());
+		return false;
+	}
+	return true;
+}
+
+/*
+ * Load() validates a mapped snapshot and fills courses with its courses,
+ * sorted by courseId, and preReqIndex with their prerequisite edges (see
+ * CourseCatalog::LoadSorted()). Every size, offset and the checksum are
+ * checked before anything is read, the stored keys must belong to their
+ * IDs and increase strictly, an edge may not also store a name, and a
+ * stored name may not be in the catalog, so a truncated or corrupt file
+ * is rejected. An edge's prerequisite ID is copied from the course it
+ * points at instead of the pool.
+ *
+ * @param data, size (mapped file), vector<Course>& courses, vector<int64_t>& preReqIndex
+ * @return bool false if the snapshot is invalid
+ */
+bool CatalogSnapshot::Load(const char* data, size_t size, vector<Course>& courses, vector<int64_t>& preReqIndex) {
+	if (!IsSnapshot(data, size)) {
+		return false;
+	}
+	SnapshotHeader header;
+	memcpy(&header, data, sizeof(header));
+	if (header.version != VERSION) {
+		return false;
+	}
+
+	//Sections must add up to the file size exactly
+	uint64_t count = header.courseCount;
+	uint64_t bodyBytes = size - sizeof(SnapshotHeader);
+	uint64_t perCourse = sizeof(CourseKey) + sizeof(SnapshotRecord);
+	if (count > bodyBytes / perCourse || count * perCourse + header.poolBytes != bodyBytes) {
+		return false;
+	}
+	const char* body = data + sizeof(SnapshotHeader);
+	if (Checksum(body, bodyBytes) != header.checksum) {
+		return false;
+	}
+
+	const CourseKey* keys = reinterpret_cast<const CourseKey*>(body);
+	const SnapshotRecord* records = reinterpret_cast<const SnapshotRecord*>(body + count * sizeof(CourseKey));
+	const char* pool = body + count * perCourse;
+	auto inPool = [&header](const PoolString& stored) {
+		return stored.offset <= header.poolBytes && stored.length <= header.poolBytes - stored.offset;
+	};
+
+	courses.clear();
+	preReqIndex.clear();
+	courses.resize(count);
+	preReqIndex.reserve(2 * count);
+	for (uint64_t i = 0; i < count; ++i) {
+		const SnapshotRecord& record = records[i];
+		if (!inPool(record.courseId) || !inPool(record.courseName)
+			|| !inPool(record.preReq1) || !inPool(record.preReq2)) {
+			return false;
+		}
+		Course& aCourse = courses[i];
+		aCourse.courseId.assign(pool + record.courseId.offset, record.courseId.length);
+		aCourse.courseName.assign(pool + record.courseName.offset, record.courseName.length);
+
+		//Keys in strictly increasing order mean the courses need no sorting and have no repeated IDs
+		if (CompareKeys(keys[i], CourseKey(aCourse.courseId)) != 0
+			|| (i > 0 && CompareCourseIds(keys[i - 1], courses[i - 1].courseId, keys[i], aCourse.courseId) >= 0)) {
+			return false;
+		}
+		const PoolString* names[] = { &record.preReq1, &record.preReq2 };
+		string* links[] = { &aCourse.preReq1, &aCourse.preReq2 };
+		int32_t edges[] = { record.preReq1Index, record.preReq2Index };
+		for (size_t k = 0; k < 2; ++k) {
+			if (edges[k] < -1 || edges[k] >= static_cast<int64_t>(count) || (edges[k] >= 0 && names[k]->length != 0)) {
+				return false;
+			}
+			if (edges[k] < 0) {
+				links[k]->assign(pool + names[k]->offset, names[k]->length);
+			}
+			preReqIndex.push_back(edges[k]);
+		}
+	}
+
+	//Edges take their prerequisite's ID, and -1 may only stand for one outside the catalog
+	auto byCourseId = [](const Course& aCourse, const string& courseId) {
+		return aCourse.courseId < courseId;
+	};
+	for (uint64_t i = 0; i < count; ++i) {
+		string* links[] = { &courses[i].preReq1, &courses[i].preReq2 };
+		for (size_t k = 0; k < 2; ++k) {
+			int64_t edge = preReqIndex[2 * i + k];
+			if (edge >= 0) {
+				*links[k] = courses[edge].courseId;
+			}
+			else if (!links[k]->empty()) {
+				auto found = lower_bound(courses.begin(), courses.end(), *links[k], byCourseId);
+				if (found != courses.end() && found->courseId == *links[k]) {
+					return false;
+				}
+			}
+		}
+	}
+	return true;
+}
+
+
+class Parser {
+private:
+	static const size_t PARALLEL_CHUNK_BYTES = 4 * 1024 * 1024; //Smallest chunk worth a thread
+
+public:
+	Parser();
+	Parser(string fileName, CourseCatalog* bst);
+	~Parser();
+
+
+};
+
+Parser::Parser() {
+
+}
+
+Parser::~Parser() {
+
+}
+/*
+* ParseLine splits one line of the mapped file on commas.
+* Tokens are views into the file, nothing is copied or allocated.
+* Like splitting with getline(), an empty field after the last comma
+* is not counted as a token, and only the first MAX_TOKENS are kept.
+*
+* @param line //one line, without its newline
+* @param tokens //filled with up to MAX_TOKENS views
+* @return number of tokens found
+*/
+const size_t MAX_TOKENS = 4; //courseId, courseName, preReq1, preReq2
+
+size_t ParseLine(string_view line, string_view tokens[]) {
+	size_t count = 0;
+	size_t start = 0;
+
+	while (start < line.size() && count < MAX_TOKENS) {
+		size_t comma = line.find(',', start);
+		if (comma == string_view::npos) { //last token runs to end of line
+			comma = line.size();
+		}
+		tokens[count++] = line.substr(start, comma - start);
+		start = comma + 1;
+	}
+	return count;
+}
+
+/*
+* ParseLines parses every line in [first, last) into courses,
+* copying each field straight from the file into its Course.
+* Windows line endings are accepted (the '\r' is dropped).
+*
+* @param first, last //range of the mapped file
+* @param courses //parsed courses are appended here
+* @return number of lines in the wrong format (skipped)
+*/
+size_t ParseLines(const char* first, const char* last, vector<Course>& courses) {
+	string_view tokens[MAX_TOKENS];
+	size_t wrongFormat = 0;
+
+	while (first < last) {
+		const char* end = static_cast<const char*>(memchr(first, '\n', last - first));
+		if (end == nullptr) { //last line has no newline
+			end = last;
+		}
+		string_view line(first, end - first);
+		if (!line.empty() && line.back() == '\r') {
+			line.remove_suffix(1);
+		}
+		first = end + 1;
+
+		size_t count = ParseLine(line, tokens);
+		if (count < 2) { //Error format for line too small (< 2)
+			++wrongFormat;
+			continue;
+		}
+
+		courses.emplace_back();
+		Course& aCourse = courses.back();
+		aCourse.courseId.assign(tokens[0].data(), tokens[0].size()); //first token is courseId
+		aCourse.courseName.assign(tokens[1].data(), tokens[1].size()); //second token is courseName
+		if (count > 2) { //preReqs stay empty if they don't exist
+			aCourse.preReq1.assign(tokens[2].data(), tokens[2].size());
+		}
+		if (count > 3) {
+			aCourse.preReq2.assign(tokens[3].data(), tokens[3].size());
+		}
+	}
+	return wrongFormat;
+}
+
+/*
+ * CountLines counts newlines in [first, last) so the course batch
+ * can be allocated once up front
+ *
+ * @param first, last
+ * @return number of lines (a final line without newline included)
+ */
+size_t CountLines(const char* first, const char* last) {
+	size_t lines = 0;
+	while (first < last) {
+		const char* end = static_cast<const char*>(memchr(first, '\n', last - first));
+		++lines;
+		if (end == nullptr) {
+			break;
+		}
+		first = end + 1;
+	}
+	return lines;
+}
+
+/*
+ * ParseParallel is the multi-threaded version of ParseLines for large files.
+ * [first, last) is cut into one chunk per thread, with every cut moved forward
+ * to the next line boundary. Each worker parses its chunk into its own
+ * vector and stable sorts it by courseId. The chunks are then joined in file
+ * order and merged pairwise (also in parallel) into one sorted batch.
+ * Stable sorting and merging keep repeated course IDs in file order, so
+ * BulkLoad() sees repeated IDs in the same order as on the sequential path.
+ *
+ * @param first, last //range of the mapped file
+ * @param courses //sorted parsed courses are appended here
+ * @param threadCount //number of worker threads (> 1)
+ * @return number of lines in the wrong format (skipped)
+ */
+size_t ParseParallel(const char* first, const char* last, vector<Course>& courses, unsigned threadCount) {
+	auto byCourseId = [](const Course& a, const Course& b) {
+		return a.courseId < b.courseId;
+	};
+
+	if (first == last) { //Nothing to split
+		return 0;
+	}
+
+	//Chunk boundaries, each one just past a newline
+	vector<const char*> cuts;
+	cuts.push_back(first);
+	size_t chunkSize = (last - first) / threadCount;
+	for (unsigned i = 1; i < threadCount; ++i) {
+		const char* cut = first + chunkSize * i;
+		if (cut < cuts.back()) { //previous chunk's line ran past this cut
+			cut = cuts.back();
+		}
+		const char* newline = static_cast<const char*>(memchr(cut, '\n', last - cut));
+		cuts.push_back(newline == nullptr ? last : newline + 1);
+	}
+	cuts.push_back(last);
+
+	vector<vector<Course>> chunks(threadCount);
+	vector<size_t> wrongFormat(threadCount, 0);
+	vector<thread> workers;
+	for (unsigned i = 0; i < threadCount; ++i) {
+		workers.emplace_back([&, i]() {
+			chunks[i].reserve(CountLines(cuts[i], cuts[i + 1]));
+			wrongFormat[i] = ParseLines(cuts[i], cuts[i + 1], chunks[i]);
+			stable_sort(chunks[i].begin(), chunks[i].end(), byCourseId);
+		});
+	}
+	for (thread& worker : workers) {
+		worker.join();
+	}
+
+	//Join the sorted runs in file order, remembering where each one starts
+	size_t total = 0;
+	size_t wrongTotal = 0;
+	for (unsigned i = 0; i < threadCount; ++i) {
+		total += chunks[i].size();
+		wrongTotal += wrongFormat[i];
+	}
+	size_t base = courses.size();
+	courses.reserve(base + total);
+	vector<size_t> runs;
+	for (vector<Course>& chunk : chunks) {
+		runs.push_back(courses.size());
+		courses.insert(courses.end(), make_move_iterator(chunk.begin()), make_move_iterator(chunk.end()));
+		vector<Course>().swap(chunk); //free the moved-from chunk
+	}
+	runs.push_back(courses.size());
+
+	//Merge neighbouring runs until one is left, each round's merges in parallel
+	while (runs.size() > 2) {
+		vector<size_t> merged;
+		workers.clear();
+		for (size_t r = 0; r + 1 < runs.size(); r += 2) {
+			merged.push_back(runs[r]);
+			if (r + 2 < runs.size()) { //a pair to merge
+				auto begin = courses.begin();
+				size_t low = runs[r], middle = runs[r + 1], high = runs[r + 2];
+				workers.emplace_back([=]() {
+					inplace_merge(begin + low, begin + middle, begin + high, byCourseId);
+				});
+			}
+		}
+		merged.push_back(runs.back());
+		for (thread& worker : workers) {
+			worker.join();
+		}
+		runs.swap(merged);
+	}
+	return wrongTotal;
+}
+
+
+/*
+ * Parser() function that maps the csv file into memory and passes it
+ * to ParseLines(), which splits each line into fields and copies them
+ * straight into Course objects. Files of several megabytes are parsed
+ * in parallel chunks by ParseParallel() instead. The courses are collected
+ * into a batch, which is inserted into the BST with one BulkLoad() call
+ *
+ *@param String fileName, CourseCatalog bst
+ *
+*/
+Parser::Parser(string fileName, CourseCatalog* bst) {
+	MappedFile inputFile; //file to be read
+	vector<Course> batch; //every course read from the file
+
+	if (inputFile.Open(fileName)) { //only do while file is open
+		const char* first = inputFile.Data();
+		const char* last = first + inputFile.Size();
+		[[maybe_unused]] chrono::steady_clock::time_point parseStart = chrono::steady_clock::now();
+		auto recordParse = [&]() { //Parse time for the stats report, excluding the load itself
+			STAT_ADD(parsedBytes, inputFile.Size());
+			STAT_ADD(parseNanos, chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - parseStart).count());
+		};
+
+		if (CatalogSnapshot::IsSnapshot(first, inputFile.Size())) { //Binary snapshot, no parsing needed
+			vector<int64_t> preReqIndex;
+			if (!CatalogSnapshot::Load(first, inputFile.Size(), batch, preReqIndex)) {
+				cout << fileName << " is not a valid course snapshot." << endl;
+				return;
+			}
+			recordParse();
+			bst->LoadSorted(batch, preReqIndex);
+			cout << endl << batch.size() << " courses added to course list." << endl << endl; //display menu message
+			return;
+		}
+
+		//One thread per PARALLEL_CHUNK_BYTES of input, up to the core count
+		size_t threadCount = inputFile.Size() / PARALLEL_CHUNK_BYTES;
+		size_t cores = thread::hardware_concurrency();
+		if (threadCount > cores) {
+			threadCount = cores;
+		}
+
+		size_t wrongFormat;
+		if (threadCount > 1) {
+			wrongFormat = ParseParallel(first, last, batch, static_cast<unsigned>(threadCount));
+		}
+		else {
+			batch.reserve(CountLines(first, last));
+			wrongFormat = ParseLines(first, last, batch);
+		}
+		for (size_t i = 0; i < wrongFormat; ++i) {
+			cout << "Wrong format" << endl;
+		}
+
+		recordParse();
+		bst->BulkLoad(batch); //insert the whole file into BST
+		cout << endl << batch.size() << " courses added to course list." << endl << endl; //display menu message
+	}
+	else { //Output file not open error message
+		cout << fileName + " is not open." << endl;
+	}
+}
+
+/*
+ * LoadFile() loads a course file or snapshot into the catalog, like the
+ * menu's Load Courses File
+ *
+ * @param string fileName
+ */
+void CourseCatalog::LoadFile(const string& fileName) {
+	Parser load(fileName, this);
+}
+
+
+/*
+ * OperationLog is the append-only write-ahead log behind --log <file>.
+ * Each catalog change is one text record (see LoggedCatalog); the file
+ * starts with a header line "ABCULOG,<generation>,<base>": the number of
+ * times it has been compacted, and the size and checksum of the base file
+ * the records start from.
+ * Records are buffered by Append() and made durable by Commit() with group
+ * commit: the first committer to find no write in progress writes every
+ * record appended so far, its own and other threads', with one write and
+ * one fsync, while later committers wait for that group or lead the next.
+ * A run of changes committed once costs one fsync, not one per change.
+ */
+class OperationLog {
+private:
+	int fileDescriptor;
+	string fileName;
+	mutex lock;
+	condition_variable groupWritten;
+	string pending;     //Appended records not yet written
+	uint64_t appended;  //Bytes appended since the file was opened
+	uint64_t durable;   //Bytes of those known to be on disk
+	uint64_t fileBytes; //Size of the file once pending is written
+	bool writing;       //A committer is writing a group
+	bool failed;        //A write or fsync failed, later commits report it
+
+	static bool writeAll(int descriptor, const char* data, size_t size);
+	static bool syncDescriptor(int descriptor);
+
+public:
+	static const char HEADER[];
+
+	OperationLog();
+	~OperationLog();
+	OperationLog(const OperationLog&) = delete;
+	OperationLog& operator=(const OperationLog&) = delete;
+
+	bool Open(const string& fileName, uint64_t validBytes); //Appends after the first validBytes
+	bool Create(const string& fileName, uint64_t generation, const string& base); //Atomically replaces fileName with an empty log
+	void Close();
+	uint64_t Append(string_view records); //Returns the sequence to commit
+	bool Commit(uint64_t sequence);       //Waits until every record up to sequence is on disk
+	bool Sync();                          //Commits everything appended so far
+	uint64_t Size();                      //Bytes in the file, including pending records
+};
+
+const char OperationLog::HEADER[] = "ABCULOG,";
+
+OperationLog::OperationLog() {
+	fileDescriptor = -1;
+	appended = 0;
+	durable = 0;
+	fileBytes = 0;
+	writing = false;
+	failed = false;
+}
+
+OperationLog::~OperationLog() {
+	Sync();
+	Close();
+}
+
+/*
+ * writeAll() writes all of data, retrying short writes like FileSink
+ *
+ * @param descriptor, data, size
+ * @return bool false if the write failed
+ */
+bool OperationLog::writeAll(int descriptor, const char* data, size_t size) {
+	while (size > 0) {
+#ifdef _WIN32
+		int written = _write(descriptor, data, static_cast<unsigned>(size < INT_MAX ? size : INT_MAX));
+#else
+		ssize_t written = write(descriptor, data, size);
+		if (written < 0 && errno == EINTR) {
+			continue;
+		}
+#endif
+		if (written <= 0) {
+			return false;
+		}
+		data += written;
+		size -= static_cast<size_t>(written);
+	}
+	return true;
+}
+
+//Flushes a descriptor's data to the disk
+bool OperationLog::syncDescriptor(int descriptor) {
+#ifdef _WIN32
+	return _commit(descriptor) == 0;
+#else
+	return fsync(descriptor) == 0;
+#endif
+}
+
+/*
+ * Open() opens fileName for appending after its first validBytes, cutting
+ * off anything after them (the torn tail of a crashed write)
+ *
+ * @param string fileName, uint64_t validBytes
+ * @return bool false if the file could not be opened
+ */
+bool OperationLog::Open(const string& fileName, uint64_t validBytes) {
+	Close();
+#ifdef _WIN32
+	fileDescriptor = _open(fileName.c_str(), _O_WRONLY | _O_CREAT | _O_APPEND | _O_BINARY, _S_IREAD | _S_IWRITE);
+	if (fileDescriptor >= 0 && _chsize_s(fileDescriptor, static_cast<long long>(validBytes)) != 0) {
+		Close();
+	}
+#else
+	fileDescriptor = open(fileName.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+	if (fileDescriptor >= 0 && ftruncate(fileDescriptor, static_cast<off_t>(validBytes)) != 0) {
+		Close();
+	}
+#endif
+	if (fileDescriptor < 0) {
+		return false;
+	}
+	this->fileName = fileName;
+	fileBytes = validBytes;
+	failed = false;
+	return true;
+}
+
+/*
+ * Create() starts an empty log for generation: the header is written and
+ * synced to a temporary file that then replaces fileName, so a crash
+ * leaves either the old log or the new one
+ *
+ * @param string fileName, uint64_t generation, string base (identity of the base file)
+ * @return bool
+ */
+bool OperationLog::Create(const string& fileName, uint64_t generation, const string& base) {
+	string header = HEADER + to_string(generation) + "," + base + "\n";
+	string temporary = fileName + ".tmp";
+	OperationLog empty;
+	bool written = empty.Open(temporary, 0) && writeAll(empty.fileDescriptor, header.data(), header.size())
+		&& syncDescriptor(empty.fileDescriptor);
+	empty.Close();
+	if (!written || !ReplaceFile(temporary, fileName)) {
+		remove(temporary.c_str());
+		return false;
+	}
+	return Open(fileName, header.size());
+}
+
+void OperationLog::Close() {
+	if (fileDescriptor >= 0) {
+#ifdef _WIN32
+		_close(fileDescriptor);
+#else
+		close(fileDescriptor);
+#endif
+	}
+	fileDescriptor = -1;
+}
+
+/*
+ * Append() adds complete records (each ending in '\n') to the log buffer.
+ * They are not durable until a Commit() reaches the returned sequence.
+ *
+ * @param string_view records
+ * @return uint64_t sequence
+ */
+uint64_t OperationLog::Append(string_view records) {
+	lock_guard<mutex> guard(lock);
+	pending.append(records.data(), records.size());
+	appended += records.size();
+	fileBytes += records.size();
+	STAT_ADD(logRecords, count(records.begin(), records.end(), '\n'));
+	return appended;
+}
+
+/*
+ * Commit() returns once every record up to sequence is on disk. If no
+ * other thread is writing, this one takes the whole buffer as one group;
+ * otherwise it waits, and leads the next group if its records missed the
+ * current one.
+ *
+ * @param uint64_t sequence
+ * @return bool false if the log could not be written
+ */
+bool OperationLog::Commit(uint64_t sequence) {
+	unique_lock<mutex> guard(lock);
+	while (durable < sequence && !failed) {
+		if (writing) {
+			groupWritten.wait(guard);
+			continue;
+		}
+		writing = true;
+		string group;
+		group.swap(pending);
+		uint64_t groupEnd = appended;
+		guard.unlock();
+
+		bool written = fileDescriptor >= 0 && writeAll(fileDescriptor, group.data(), group.size())
+			&& syncDescriptor(fileDescriptor);
+		STAT_ADD(logSyncs, 1);
+
+		guard.lock();
+		writing = false;
+		if (written) {
+			durable = groupEnd;
+		}
+		else {
+			failed = true;
+		}
+		groupWritten.notify_all();
+	}
+	return !failed;
+}
+
+bool OperationLog::Sync() {
+	uint64_t sequence;
+	{
+		lock_guard<mutex> guard(lock);
+		sequence = appended;
+	}
+	return Commit(sequence);
+}
+
+uint64_t OperationLog::Size() {
+	lock_guard<mutex> guard(lock);
+	return fileBytes;
+}
+
+const uint64_t LOG_COMPACT_BYTES = 64ULL * 1024 * 1024; //Log size that triggers a compaction
+
+/*
+ * LoggedCatalog wraps a catalog so its changes survive a restart
+ * (--log <file>). Each successful change is applied and then appended to
+ * the OperationLog under one lock, so the log holds them in the order
+ * they happened. Commit() makes them durable; the menu commits after each
+ * change and batch scripts after each run of commands, so a whole run
+ * shares one fsync. Records, one per line:
+ *   I,<courseId>,<courseName>,<preReq1>,<preReq2>  InsertCourse()
+ *   D,<courseId>                                   DeleteCourseWithDependencyCheck()
+ *   C,<courseId>                                   DeleteCascade() (a run of them is one call)
+ *   B,<count>                                      BulkLoad() of the next count lines,
+ *   L,<courseId>,<courseName>,<preReq1>,<preReq2>  which are the batch as it was passed
+ *   R,<bytes>,<checksum>                           LoadFile() of the course file again
+ * Replaying the records against the same starting catalog repeats every
+ * change exactly, refused cycles included. A course name may contain
+ * commas, it is everything between the ID and the last two fields.
+ * Reloading the course file logs only its identity (size and checksum),
+ * not a copy of every course in it; replay loads the file again and
+ * stops with an error if it has changed since.
+ *
+ * Recover() loads the base (the course file, or after a compaction the
+ * snapshot <log>.<generation>.base) and replays the log on top, refusing
+ * to if the base is not the file the header names. Once the log passes
+ * LOG_COMPACT_BYTES, Commit() folds it into a new base: the catalog is
+ * saved as the next generation's snapshot and synced, then an empty log
+ * naming that generation replaces the old log in one rename. A crash at
+ * any point leaves a matching base and log.
+ */
+class LoggedCatalog : public CourseCatalog {
+private:
+	CourseCatalog* catalog; //Owned
+	OperationLog log;
+	string logFile;
+	uint64_t generation;
+	string courseFile;     //File the log started from, for R records
+	string courseIdentity; //Its identity when Recover() ran
+	mutex applying; //Changes are applied and logged in one order
+
+	void mergeSorted(vector<Course>& courses) override { catalog->mergeSorted(courses); }
+	void eraseEach(const vector<string>& courseIds) override { catalog->eraseEach(courseIds); }
+	void eraseSorted(const vector<string>& doomed) override { catalog->eraseSorted(doomed); }
+	unique_lock<mutex> lockWriters() override { return catalog->lockWriters(); }
+
+	string baseFile(uint64_t generation) const;
+	bool compact();
+	static void appendCourse(string& records, char type, const Course& course);
+	static bool parseCourse(string_view fields, Course& course);
+	static string fileIdentity(const string& fileName);
+	size_t replay(const char* first, const char* last, uint64_t& validBytes, bool& baseChanged);
+
+public:
+	LoggedCatalog(CourseCatalog* catalog, const string& logFile);
+	~LoggedCatalog();
+	LoggedCatalog(const LoggedCatalog&) = delete;
+	LoggedCatalog& operator=(const LoggedCatalog&) = delete;
+
+	bool Recover(const string& courseFile); //Loads the base and replays the log, false if the log is unusable
+	CourseCatalog* Catalog() const { return catalog; }
+
+	void InOrder(OutputSink& sink) override { catalog->InOrder(sink); }
+	void InOrderPage(size_t first, size_t count, OutputSink& sink) const override { catalog->InOrderPage(first, count, sink); }
+	bool InsertCourse(Course course) override;
+	void BulkLoad(vector<Course>& courses) override;
+	void LoadSorted(vector<Course>& courses, const vector<int64_t>& preReqIndex) override;
+	const Course* Search(string_view courseId) const override { return catalog->Search(courseId); }
+	void SearchMany(const vector<string_view>& courseIds, vector<const Course*>& results) const override { catalog->SearchMany(courseIds, results); }
+	size_t Size() const override { return catalog->Size(); }
+	bool DeleteCourseWithDependencyCheck(const string& courseId) override;
+	void DeleteCascade(const vector<string>& courseIds, vector<string>& removed) override;
+	void CollectCourses(vector<const Course*>& sorted) const override { catalog->CollectCourses(sorted); }
+	PrerequisiteGraph& Prerequisites() override { return catalog->Prerequisites(); }
+	void Shape(TreeShape& shape) const override { catalog->Shape(shape); }
+	void Commit() override;
+	void LoadFile(const string& fileName) override;
+};
+
+LoggedCatalog::LoggedCatalog(CourseCatalog* catalog, const string& logFile) : catalog(catalog), logFile(logFile) {
+	generation = 0;
+}
+
+LoggedCatalog::~LoggedCatalog() {
+	log.Sync();
+	log.Close();
+	delete catalog;
+}
+
+string LoggedCatalog::baseFile(uint64_t generation) const {
+	return logFile + "." + to_string(generation) + ".base";
+}
+
+//Appends one course record: type,courseId,courseName,preReq1,preReq2
+void LoggedCatalog::appendCourse(string& records, char type, const Course& course) {
+	records += type;
+	records += ',';
+	records += course.courseId;
+	records += ',';
+	records += course.courseName;
+	records += ',';
+	records += course.preReq1;
+	records += ',';
+	records += course.preReq2;
+	records += '\n';
+}
+
+/*
+ * fileIdentity() returns "<bytes>,<checksum>" of a file, which tells a
+ * base or course file apart from an edited one, or "" if it can not be read
+ *
+ * @param string fileName
+ * @return string
+ */
+string LoggedCatalog::fileIdentity(const string& fileName) {
+	MappedFile file;
+	if (!file.Open(fileName)) {
+		return "";
+	}
+	uint64_t checksum = file.Size() == 0 ? 0 : CatalogSnapshot::Checksum(file.Data(), file.Size());
+	return to_string(file.Size()) + "," + to_string(checksum);
+}
+
+/*
+ * parseCourse() reads the fields of a course record (after "I," or "L,")
+ *
+ * @param string_view fields, Course& course
+ * @return bool false if a field is missing
+ */
+bool LoggedCatalog::parseCourse(string_view fields, Course& course) {
+	size_t idEnd = fields.find(',');
+	size_t preReq2Start = fields.rfind(',');
+	if (idEnd == string_view::npos || preReq2Start == idEnd) {
+		return false;
+	}
+	size_t preReq1Start = fields.rfind(',', preReq2Start - 1);
+	if (preReq1Start == idEnd) {
+		return false;
+	}
+	course.courseId.assign(fields.data(), idEnd);
+	course.courseName.assign(fields.data() + idEnd + 1, preReq1Start - idEnd - 1);
+	course.preReq1.assign(fields.data() + preReq1Start + 1, preReq2Start - preReq1Start - 1);
+	course.preReq2.assign(fields.data() + preReq2Start + 1, fields.size() - preReq2Start - 1);
+	return true;
+}
+
+/*
+ * replay() applies the records in [first, last) (after the header) to the
+ * wrapped catalog. It stops at the first record that is incomplete or
+ * unreadable, which can only be the tail of a write cut off by a crash,
+ * and at a reload of a course file that has changed since.
+ *
+ * @param first, last, validBytes (set to the bytes of whole records),
+ *        baseChanged (set if replay stopped at a changed course file)
+ * @return size_t records replayed
+ */
+size_t LoggedCatalog::replay(const char* first, const char* last, uint64_t& validBytes, bool& baseChanged) {
+	const char* start = first;
+	size_t records = 0;
+	vector<string> cascade; //A run of C records, replayed as one call
+	auto flushCascade = [&]() {
+		if (!cascade.empty()) {
+			vector<string> removed;
+			catalog->DeleteCascade(cascade, removed);
+			cascade.clear();
+		}
+	};
+	auto nextLine = [&last](const char*& position, string_view& line) {
+		const char* end = static_cast<const char*>(memchr(position, '\n', last - position));
+		if (end == nullptr) {
+			return false;
+		}
+		line = string_view(position, end - position);
+		position = end + 1;
+		return line.size() >= 2 && line[1] == ',';
+	};
+
+	baseChanged = false;
+	const char* position = first;
+	string_view line;
+	while (position < last && nextLine(position, line)) {
+		char type = line[0];
+		string_view fields = line.substr(2);
+		if (type != 'C') {
+			flushCascade();
+		}
+
+		if (type == 'I') {
+			Course course;
+			if (!parseCourse(fields, course)) {
+				break;
+			}
+			catalog->InsertCourse(move(course));
+		}
+		else if (type == 'D') {
+			catalog->DeleteCourseWithDependencyCheck(string(fields));
+		}
+		else if (type == 'C') {
+			cascade.emplace_back(fields);
+		}
+		else if (type == 'B') {
+			size_t count = strtoull(string(fields).c_str(), nullptr, 10);
+			vector<Course> batch;
+			batch.reserve(min<size_t>(count, (last - position) / 6)); //A record is at least "L,,,,\n"
+			bool whole = true;
+			while (whole && batch.size() < count) {
+				batch.emplace_back();
+				whole = nextLine(position, line) && line[0] == 'L' && parseCourse(line.substr(2), batch.back());
+			}
+			if (!whole) { //Group cut off
+				break;
+			}
+			catalog->BulkLoad(batch);
+		}
+		else if (type == 'R') {
+			if (fields != fileIdentity(courseFile)) {
+				baseChanged = true;
+				break;
+			}
+			catalog->LoadFile(courseFile);
+		}
+		else {
+			break;
+		}
+		++records;
+		first = position; //Everything up to here was whole
+	}
+	flushCascade();
+	validBytes = first - start;
+	return records;
+}
+
+/*
+ * Recover() rebuilds the catalog from the base and the log, then opens
+ * the log for new records. A log that does not exist yet is started empty,
+ * on top of courseFile; one that exists but can not be read is an error,
+ * never replaced.
+ *
+ * @param string courseFile (the CSV or snapshot the log started from)
+ * @return bool false if logFile can not be opened, is not a log, or its
+ *         base has changed since the log was written
+ */
+bool LoggedCatalog::Recover(const string& courseFile) {
+	this->courseFile = courseFile;
+	courseIdentity = fileIdentity(courseFile);
+	MappedFile existing;
+	if (!existing.Open(logFile)) {
+		if (!FileMissing(logFile)) {
+			cout << "Error: could not open the operation log " << logFile << "." << endl;
+			return false;
+		}
+		if (!courseIdentity.empty()) {
+			Parser load(courseFile, catalog);
+		}
+		if (!log.Create(logFile, 0, courseIdentity)) {
+			cout << "Error: could not create the operation log " << logFile << "." << endl;
+			return false;
+		}
+		return true;
+	}
+
+	//Header names the generation, and so the base the records start from, and the base's identity
+	const char* data = existing.Data();
+	size_t headerSize = strlen(OperationLog::HEADER);
+	const char* headerEnd = existing.Size() < headerSize ? nullptr
+		: static_cast<const char*>(memchr(data, '\n', existing.Size()));
+	if (headerEnd == nullptr || memcmp(data, OperationLog::HEADER, headerSize) != 0) {
+		cout << "Error: " << logFile << " is not an operation log." << endl;
+		return false;
+	}
+	string_view header(data + headerSize, headerEnd - data - headerSize);
+	size_t generationEnd = header.find(',');
+	if (generationEnd == string_view::npos) {
+		cout << "Error: " << logFile << " is not an operation log." << endl;
+		return false;
+	}
+	generation = strtoull(string(header.substr(0, generationEnd)).c_str(), nullptr, 10);
+	string base = generation == 0 ? courseFile : baseFile(generation);
+	string identity = generation == 0 ? courseIdentity : fileIdentity(base);
+	if (generation != 0 && identity.empty()) {
+		cout << "Error: " << base << " is missing, " << logFile << " can not be replayed." << endl;
+		return false;
+	}
+	if (identity != header.substr(generationEnd + 1)) {
+		cout << "Error: " << base << " has changed since " << logFile << " was started, it can not be replayed." << endl;
+		return false;
+	}
+	if (!identity.empty()) {
+		Parser load(base, catalog);
+	}
+
+	ios::iostate coutState = cout.rdstate();
+	cout.setstate(ios::failbit); //The changes were reported when they were made
+	uint64_t validBytes;
+	bool baseChanged;
+	size_t records = replay(headerEnd + 1, data + existing.Size(), validBytes, baseChanged);
+	cout.clear(coutState);
+	if (baseChanged) {
+		cout << "Error: " << courseFile << " has changed since it was reloaded, " << logFile << " can not be replayed." << endl;
+		return false;
+	}
+	validBytes += headerEnd + 1 - data;
+	if (validBytes < existing.Size()) {
+		cout << "Warning: " << existing.Size() - validBytes << " bytes of an unfinished change were dropped from "
+			<< logFile << "." << endl;
+	}
+	existing.Close();
+
+	if (!log.Open(logFile, validBytes)) {
+		cout << "Error: could not open the operation log " << logFile << "." << endl;
+		return false;
+	}
+	cout << records << " logged changes replayed from " << logFile << "." << endl << endl;
+	return true;
+}
+
+/*
+ * InsertCourse() adds the course to the wrapped catalog and logs it if it
+ * was accepted
+ *
+ * @param Course course
+ * @return bool false if refused
+ */
+bool LoggedCatalog::InsertCourse(Course course) {
+	string record;
+	appendCourse(record, 'I', course);
+	lock_guard<mutex> guard(applying);
+	if (!catalog->InsertCourse(move(course))) {
+		return false;
+	}
+	log.Append(record);
+	return true;
+}
+
+/*
+ * BulkLoad() logs the batch as it was passed, then loads it. Replay
+ * repeats the same BulkLoad(), so courses refused now are refused again.
+ *
+ * @param vector<Course>& courses
+ */
+void LoggedCatalog::BulkLoad(vector<Course>& courses) {
+	string records = "B," + to_string(courses.size()) + "\n";
+	for (const Course& course : courses) {
+		appendCourse(records, 'L', course);
+	}
+	lock_guard<mutex> guard(applying);
+	catalog->BulkLoad(courses);
+	log.Append(records);
+}
+
+/*
+ * LoadSorted() logs the snapshot's courses like a BulkLoad() batch; on a
+ * valid snapshot both load the same courses
+ *
+ * @param vector<Course>& courses, vector<int64_t>& preReqIndex
+ */
+void LoggedCatalog::LoadSorted(vector<Course>& courses, const vector<int64_t>& preReqIndex) {
+	string records = "B," + to_string(courses.size()) + "\n";
+	for (const Course& course : courses) {
+		appendCourse(records, 'L', course);
+	}
+	lock_guard<mutex> guard(applying);
+	catalog->LoadSorted(courses, preReqIndex);
+	log.Append(records);
+}
+
+bool LoggedCatalog::DeleteCourseWithDependencyCheck(const string& courseId) {
+	lock_guard<mutex> guard(applying);
+	if (!catalog->DeleteCourseWithDependencyCheck(courseId)) {
+		return false;
+	}
+	log.Append("D," + courseId + "\n");
+	return true;
+}
+
+void LoggedCatalog::DeleteCascade(const vector<string>& courseIds, vector<string>& removed) {
+	lock_guard<mutex> guard(applying);
+	size_t first = removed.size();
+	catalog->DeleteCascade(courseIds, removed);
+	if (removed.size() == first) { //Nothing changed
+		return;
+	}
+	string records;
+	for (const string& courseId : courseIds) {
+		records += "C," + courseId + "\n";
+	}
+	log.Append(records);
+}
+
+/*
+ * LoadFile() loads a file through this catalog, so its courses are logged
+ * as a BulkLoad() batch, unless it is the course file the log started from,
+ * unchanged: that reload is logged as one R record naming its identity
+ *
+ * @param string fileName
+ */
+void LoggedCatalog::LoadFile(const string& fileName) {
+	string identity = fileIdentity(fileName);
+	if (identity.empty() || identity != courseIdentity) {
+		CourseCatalog::LoadFile(fileName);
+		return;
+	}
+	lock_guard<mutex> guard(applying);
+	catalog->LoadFile(fileName);
+	log.Append("R," + identity + "\n");
+}
+
+/*
+ * Commit() makes every logged change durable (one fsync for all of them,
+ * shared with other committing threads) and compacts the log once it
+ * has grown past LOG_COMPACT_BYTES
+ */
+void LoggedCatalog::Commit() {
+	if (!log.Sync()) {
+		cout << "Error: could not write the operation log " << logFile << ". Recent changes may be lost." << endl;
+		return;
+	}
+	if (log.Size() > LOG_COMPACT_BYTES && !compact()) {
+		cout << "Error: could not compact the operation log " << logFile << "." << endl;
+	}
+}
+
+/*
+ * compact() folds the log into a new base snapshot and starts an empty
+ * log for the next generation. No change can be applied meanwhile, so the
+ * snapshot holds exactly the changes of the old log. The new log naming the
+ * new generation is renamed into place last; until then the old base and
+ * log stay valid.
+ *
+ * @return bool
+ */
+bool LoggedCatalog::compact() {
+	lock_guard<mutex> guard(applying);
+	if (!log.Sync()) {
+		return false;
+	}
+	string next = baseFile(generation + 1);
+	if (!CatalogSnapshot::Save(*catalog, next)) {
+		return false;
+	}
+	if (!log.Create(logFile, generation + 1, fileIdentity(next))) {
+		remove(next.c_str());
+		return false;
+	}
+	if (generation != 0) {
+		remove(baseFile(generation).c_str());
+	}
+	++generation;
+	return true;
+}
+
+
+/*
+ * BatchRunner runs a script of catalog commands without prompts
+ * (--batch <file>, or --batch - for standard input), one per line:
+ *   load,<file>
+ *   add,<courseId>,<courseName>[,<preReq1>[,<preReq2>]]
+ *   delete,<courseId>
+ *   cascade,<courseId>    (deletes the course and every course depending on it)
+ *   find,<courseId>
+ *   list[,<version>]     (a kept version of a --persistent catalog)
+ *   version              (number and size of the current version)
+ * The script runs against the catalog main() built: the course file named
+ * on the command line if one was given (with --log, the catalog Recover()
+ * rebuilt), or an empty catalog, in which case it starts with load,<file>.
+ * Blank lines and lines starting with # are skipped. IDs are uppercased
+ * like the menu does. Each command answers with one compact line on the
+ * output sink, e.g. "add,CSCI300,ok" or "delete,CSCI100,error,prerequisite";
+ * list writes the course list followed by "list,<courses>", and a cascade
+ * run is followed by one "removed,<courseId>" line per course it deleted.
+ *
+ * Runs of the same command are gathered and executed as a group, so a long
+ * script costs about as much as loading a file:
+ *   add    - each prerequisite must be a course once its add runs: one
+ *            already in the catalog, or one added earlier in the run's
+ *            prerequisite order. Adds needing a failed add fail too, and
+ *            adds of the run that need each other fail as a cycle. A run
+ *            that is large next to the catalog goes in with one BulkLoad()
+ *            and every add of an ID reports the ID's final outcome
+ *   delete - the run is deleted dependents first, in one pass, so a run
+ *            may list courses in any order
+ *   cascade - the whole run is one DeleteCascade() call
+ *   find   - looked up together with SearchMany()
+ * Results are still written in script order. With --log, each run is
+ * committed to the operation log (one fsync) before its results are written.
+ */
+class BatchRunner {
+private:
+	enum class Command { None, Add, Delete, Cascade, Find };
+
+	static const size_t BULK_FRACTION = 8; //Adds go through BulkLoad() once a run is 1/8 of the catalog
+
+	CourseCatalog* catalog;
+	PersistentCourseTree* versions; //catalog if it keeps versions, else nullptr
+	OutputSink& out;
+	Command pending;          //Command of the run being gathered
+	vector<Course> adds;
+	vector<string> courseIds; //IDs of the pending deletes, cascades or finds
+
+	void flush();
+	void orderAdds(vector<string>& status, vector<size_t>& order);
+	void revertMissing(const vector<size_t>& order, const unordered_map<string, Course>& before, vector<string>& status);
+	void flushAdds();
+	void flushDeletes();
+	void flushCascades();
+	void flushFinds();
+	void result(const char* command, string_view courseId, string_view status, string_view detail = "");
+	static string upper(string_view text);
+
+public:
+	BatchRunner(CourseCatalog* catalog, OutputSink& out);
+	size_t Run(const char* first, const char* last);
+};
+
+BatchRunner::BatchRunner(CourseCatalog* catalog, OutputSink& out) : catalog(catalog), out(out), pending(Command::None) {
+	LoggedCatalog* logged = dynamic_cast<LoggedCatalog*>(catalog);
+	versions = dynamic_cast<PersistentCourseTree*>(logged != nullptr ? logged->Catalog() : catalog);
+}
+
+string BatchRunner::upper(string_view text) {
+	string upperText(text);
+	for (char& character : upperText) {
+		character = static_cast<char>(toupper(static_cast<unsigned char>(character)));
+	}
+	return upperText;
+}
+
+/*
+ * result() writes one result line: command,courseId,status[,detail]
+ */
+void BatchRunner::result(const char* command, string_view courseId, string_view status, string_view detail) {
+	out.Write(command);
+	out.Put(',');
+	out.Write(courseId);
+	out.Put(',');
+	out.Write(status);
+	if (!detail.empty()) {
+		out.Put(',');
+		out.Write(detail);
+	}
+	out.Put('\n');
+}
+
+/*
+ * Run() executes the script in [first, last). Catalog messages meant for
+ * the menu are silenced while it runs; the results go to the output sink.
+ *
+ * @param first, last //the script
+ * @return number of lines that were not a valid command
+ */
+size_t BatchRunner::Run(const char* first, const char* last) {
+	string_view tokens[MAX_TOKENS];
+	size_t invalid = 0;
+	size_t lineNumber = 0;
+	ios::iostate coutState = cout.rdstate();
+	cout.setstate(ios::failbit);
+
+	while (first < last) {
+		const char* end = static_cast<const char*>(memchr(first, '\n', last - first));
+		if (end == nullptr) {
+			end = last;
+		}
+		string_view line(first, end - first);
+		if (!line.empty() && line.back() == '\r') {
+			line.remove_suffix(1);
+		}
+		first = end + 1;
+		++lineNumber;
+		if (line.empty() || line[0] == '#') {
+			continue;
+		}
+
+		//Command word, then the fields in the course file format
+		size_t comma = line.find(',');
+		string command = comma == string_view::npos ? string(line) : string(line.substr(0, comma));
+		for (char& character : command) {
+			character = static_cast<char>(tolower(static_cast<unsigned char>(character)));
+		}
+		string_view fields = comma == string_view::npos ? string_view() : line.substr(comma + 1);
+		size_t count = ParseLine(fields, tokens);
+
+		Command next = command == "add" ? Command::Add
+			: command == "delete" ? Command::Delete
+			: command == "cascade" ? Command::Cascade
+			: command == "find" ? Command::Find : Command::None;
+		if (next != pending) {
+			flush();
+		}
+
+		if (next == Command::Add && count >= 2 && !tokens[0].empty()) {
+			adds.emplace_back();
+			Course& aCourse = adds.back();
+			aCourse.courseId = upper(tokens[0]);
+			aCourse.courseName.assign(tokens[1].data(), tokens[1].size());
+			if (count > 2) {
+				aCourse.preReq1 = upper(tokens[2]);
+			}
+			if (count > 3) {
+				aCourse.preReq2 = upper(tokens[3]);
+			}
+		}
+		else if ((next == Command::Delete || next == Command::Cascade || next == Command::Find)
+			&& count >= 1 && !tokens[0].empty()) {
+			courseIds.push_back(upper(tokens[0]));
+		}
+		else if (command == "load" && count >= 1) {
+			//The whole field is the file name, commas included
+			string fileName(fields);
+			MappedFile probe;
+			if (!probe.Open(fileName)) {
+				result("load", fileName, "error", "not open");
+				continue;
+			}
+			catalog->LoadFile(fileName);
+			catalog->Commit();
+			result("load", fileName, "ok", to_string(catalog->Size()));
+		}
+		else if (command == "list" && count == 0) {
+			catalog->InOrder(out);
+			out.Write("list,");
+			out.Write(to_string(catalog->Size()));
+			out.Put('\n');
+		}
+		else if (command == "list" && count == 1 && versions != nullptr) {
+			CatalogVersion version;
+			if (!versions->Version(strtoull(string(tokens[0]).c_str(), nullptr, 10), version)) {
+				result("list", tokens[0], "error", "version not kept");
+				continue;
+			}
+			version.InOrder(out);
+			out.Write("list,");
+			out.Write(to_string(version.Size()));
+			out.Put('\n');
+		}
+		else if (command == "version" && count == 0) {
+			if (versions == nullptr) {
+				result("version", "", "error", "not versioned");
+				continue;
+			}
+			CatalogVersion version = versions->Snapshot();
+			result("version", to_string(version.Number()), "ok", to_string(version.Size()));
+		}
+		else {
+			++invalid;
+			result("error", to_string(lineNumber), "invalid command", line);
+			continue;
+		}
+		pending = next;
+	}
+	flush();
+	cout.clear(coutState);
+	return invalid;
+}
+
+/*
+ * flush() executes the run gathered so far
+ */
+void BatchRunner::flush() {
+	switch (pending) {
+	case Command::Add: flushAdds(); break;
+	case Command::Delete: flushDeletes(); break;
+	case Command::Cascade: flushCascades(); break;
+	case Command::Find: flushFinds(); break;
+	default: break;
+	}
+	pending = Command::None;
+}
+
+/*
+ * orderAdds() decides which adds of the run can go in and in what order.
+ * First, to a fixed point, an add fails when a prerequisite is neither a
+ * course nor the ID of an add that is still valid, so an add needing a
+ * failed add fails as well. Then the valid adds are ordered prerequisites
+ * first (Kahn's algorithm over their IDs, adds of one ID in script order);
+ * adds left over need each other, and fail as a prerequisite cycle.
+ *
+ * @param status (reason each add failed, empty while valid), order (indexes into adds)
+ */
+void BatchRunner::orderAdds(vector<string>& status, vector<size_t>& order) {
+	unordered_map<string_view, vector<size_t>> addsOf;   //courseId -> its adds, in script order
+	unordered_map<string_view, vector<size_t>> neededBy; //courseId -> adds listing it as a prerequisite
+	vector<string_view> ids;                             //Each ID once, in script order
+	for (size_t i = 0; i < adds.size(); ++i) {
+		vector<size_t>& same = addsOf[adds[i].courseId];
+		if (same.empty()) {
+			ids.push_back(adds[i].courseId);
+		}
+		same.push_back(i);
+		for (const string* preReq : { &adds[i].preReq1, &adds[i].preReq2 }) {
+			if (!preReq->empty()) {
+				neededBy[*preReq].push_back(i);
+			}
+		}
+	}
+
+	unordered_map<string_view, size_t> validAdds; //courseId -> its adds that are still valid
+	for (const auto& entry : addsOf) {
+		validAdds[entry.first] = entry.second.size();
+	}
+	vector<size_t> pending(adds.size());
+	for (size_t i = 0; i < adds.size(); ++i) {
+		pending[i] = i;
+	}
+	while (!pending.empty()) {
+		size_t i = pending.back();
+		pending.pop_back();
+		if (!status[i].empty()) {
+			continue;
+		}
+		for (const string* preReq : { &adds[i].preReq1, &adds[i].preReq2 }) {
+			auto valid = validAdds.find(*preReq);
+			if (status[i].empty() && !preReq->empty() && (valid == validAdds.end() || valid->second == 0)
+				&& catalog->Search(*preReq) == nullptr) {
+				status[i] = "missing prerequisite " + *preReq;
+			}
+		}
+		if (!status[i].empty() && --validAdds[adds[i].courseId] == 0) { //Last valid add of the ID, recheck what needs it
+			auto needing = neededBy.find(adds[i].courseId);
+			if (needing != neededBy.end()) {
+				pending.insert(pending.end(), needing->second.begin(), needing->second.end());
+			}
+		}
+	}
+
+	//Kahn's algorithm over the IDs with valid adds: an ID is ready once the run's adds of its prerequisites are placed
+	unordered_map<string_view, size_t> waiting; //courseId -> prerequisite IDs of the run not yet placed
+	unordered_map<string_view, vector<string_view>> dependents;
+	vector<string_view> ready;
+	for (string_view courseId : ids) {
+		if (validAdds[courseId] == 0) {
+			continue;
+		}
+		vector<string_view> preReqs;
+		for (size_t i : addsOf[courseId]) {
+			for (const string* preReq : { &adds[i].preReq1, &adds[i].preReq2 }) {
+				auto valid = validAdds.find(*preReq);
+				if (status[i].empty() && *preReq != courseId && valid != validAdds.end() && valid->second > 0
+					&& find(preReqs.begin(), preReqs.end(), *preReq) == preReqs.end()) {
+					preReqs.push_back(*preReq);
+					dependents[*preReq].push_back(courseId);
+				}
+			}
+		}
+		waiting[courseId] = preReqs.size();
+		if (preReqs.empty()) {
+			ready.push_back(courseId);
+		}
+	}
+	for (size_t next = 0; next < ready.size(); ++next) { //ready doubles as the placed list
+		for (size_t i : addsOf[ready[next]]) {
+			if (status[i].empty()) {
+				order.push_back(i);
+			}
+		}
+		for (string_view dependent : dependents[ready[next]]) {
+			if (--waiting[dependent] == 0) {
+				ready.push_back(dependent);
+			}
+		}
+	}
+	for (const auto& entry : waiting) {
+		if (entry.second > 0) {
+			for (size_t i : addsOf[entry.first]) {
+				if (status[i].empty()) {
+					status[i] = "prerequisite cycle";
+				}
+			}
+		}
+	}
+}
+
+/*
+ * revertMissing() is the bulk path's stand-in for the check the insert
+ * path makes before each add: an add whose prerequisite was refused for a
+ * cycle (and so is not a course) is taken back out, deleting its course or
+ * restoring the course it replaced from before. Marked in prerequisite
+ * order, so the marks carry along chains, and undone dependents first.
+ *
+ * @param order (from orderAdds()), before (courses the run replaced), status
+ */
+void BatchRunner::revertMissing(const vector<size_t>& order, const unordered_map<string, Course>& before, vector<string>& status) {
+	unordered_map<string_view, bool> gone; //Run IDs that will not be courses
+	vector<size_t> reverted;
+	for (size_t i : order) {
+		if (!status[i].empty()) {
+			gone.emplace(adds[i].courseId, catalog->Search(adds[i].courseId) == nullptr);
+			continue;
+		}
+		for (const string* preReq : { &adds[i].preReq1, &adds[i].preReq2 }) {
+			auto missing = gone.find(*preReq);
+			if (status[i].empty() && missing != gone.end() && missing->second) {
+				status[i] = "missing prerequisite " + *preReq;
+			}
+		}
+		if (!status[i].empty()) {
+			reverted.push_back(i);
+			gone[adds[i].courseId] = before.count(adds[i].courseId) == 0;
+		}
+	}
+	for (auto i = reverted.rbegin(); i != reverted.rend(); ++i) {
+		auto previous = before.find(adds[*i].courseId);
+		if (previous != before.end()) {
+			catalog->InsertCourse(previous->second);
+		}
+		else if (catalog->Search(adds[*i].courseId) != nullptr) {
+			catalog->DeleteCourseWithDependencyCheck(adds[*i].courseId);
+		}
+	}
+}
+
+/*
+ * flushAdds() validates and orders a run of adds (see orderAdds()) and
+ * inserts the valid ones. Small runs use InsertCourse() in prerequisite
+ * order, checking before each add that its prerequisites are courses.
+ * Large ones use one BulkLoad(), which refuses cycles in course ID order;
+ * then every add of an ID reports whether one of them is the stored course,
+ * and revertMissing() takes out adds whose prerequisite was refused.
+ */
+void BatchRunner::flushAdds() {
+	vector<string> status(adds.size());
+	vector<size_t> order;
+	orderAdds(status, order);
+
+	if (order.size() * BULK_FRACTION >= catalog->Size()) {
+		unordered_map<string, Course> before; //Courses the run replaces, to restore if an add is reverted
+		vector<Course> valid;
+		valid.reserve(order.size());
+		for (size_t i : order) {
+			const Course* stored = catalog->Search(adds[i].courseId);
+			if (stored != nullptr) {
+				before.emplace(stored->courseId, *stored);
+			}
+			valid.push_back(adds[i]);
+		}
+		catalog->BulkLoad(valid);
+
+		unordered_map<string_view, bool> accepted; //courseId -> the stored course is one of its adds
+		for (size_t i : order) {
+			const Course* stored = catalog->Search(adds[i].courseId);
+			bool same = stored != nullptr && stored->courseName == adds[i].courseName
+				&& stored->preReq1 == adds[i].preReq1 && stored->preReq2 == adds[i].preReq2;
+			accepted[adds[i].courseId] = accepted[adds[i].courseId] || same;
+		}
+		for (size_t i : order) {
+			status[i] = accepted[adds[i].courseId] ? "" : "prerequisite cycle";
+		}
+		revertMissing(order, before, status);
+	}
+	else {
+		for (size_t i : order) {
+			for (const string* preReq : { &adds[i].preReq1, &adds[i].preReq2 }) {
+				if (status[i].empty() && !preReq->empty() && catalog->Search(*preReq) == nullptr) {
+					status[i] = "missing prerequisite " + *preReq; //Its add was refused
+				}
+			}
+			if (status[i].empty() && !catalog->InsertCourse(adds[i])) {
+				status[i] = "prerequisite cycle";
+			}
+		}
+	}
+	catalog->Commit(); //The run is durable before any of it is reported
+
+	for (size_t i = 0; i < adds.size(); ++i) {
+		if (status[i].empty()) {
+			result("add", adds[i].courseId, "ok");
+		}
+		else {
+			result("add", adds[i].courseId, "error", status[i]);
+		}
+	}
+	adds.clear();
+}
+
+/*
+ * flushDeletes() deletes a run of courses in one pass, dependents first
+ * (PrerequisiteGraph::SortDependentsFirst()), so a course needed only by
+ * courses of the run is free by the time its turn comes. Deletes refused
+ * then are needed by a course outside the run.
+ */
+void BatchRunner::flushDeletes() {
+	vector<string> sorted(courseIds);
+	catalog->Prerequisites().SortDependentsFirst(sorted);
+	unordered_map<string, const char*> status;
+	for (const string& courseId : sorted) {
+		if (status.count(courseId) != 0) { //Listed twice, reported as found once
+			continue;
+		}
+		if (catalog->DeleteCourseWithDependencyCheck(courseId)) {
+			status[courseId] = "ok";
+		}
+		else {
+			status[courseId] = catalog->Search(courseId) == nullptr ? "not found" : "prerequisite";
+		}
+	}
+	catalog->Commit();
+
+	for (const string& courseId : courseIds) {
+		const char*& outcome = status[courseId];
+		if (outcome[0] == 'o') {
+			result("delete", courseId, "ok");
+			outcome = "not found"; //A later delete of the ID finds nothing
+		}
+		else {
+			result("delete", courseId, "error", outcome);
+		}
+	}
+	courseIds.clear();
+}
+
+/*
+ * flushCascades() deletes a run of courses and all their dependents with
+ * one DeleteCascade(), so the closure is computed once for the whole run
  */
+void BatchRunner::flushCascades() {
+	vector<bool> found(courseIds.size());
+	for (size_t i = 0; i < courseIds.size(); ++i) {
+		found[i] = catalog->Search(courseIds[i]) != nullptr;
+	}
+	vector<string> removed;
+	catalog->DeleteCascade(courseIds, removed);
+	catalog->Commit();
 
-void BinarySearchTree::InOrder() {
-	this->inOrder(root);
+	for (size_t i = 0; i < courseIds.size(); ++i) {
+		if (found[i]) {
+			result("cascade", courseIds[i], "ok");
+		}
+		else {
+			result("cascade", courseIds[i], "error", "not found");
+		}
+	}
+	for (const string& courseId : removed) {
+		out.Write("removed,");
+		out.Write(courseId);
+		out.Put('\n');
+	}
+	courseIds.clear();
 }
 
 /*
- * Recursive inOrder() function that traveses down
- * the left side of the tree, printing from left to right
- * With DisplayNode() function call, and moving up
- * a node with each traversal
- * Called once from main as option 2
- *
- * @param Node node
+ * flushFinds() looks up a run of course IDs in one SearchMany() call and
+ * writes each course as find,courseId,ok,courseName,preReq1,preReq2
  */
+void BatchRunner::flushFinds() {
+	vector<string_view> lookups(courseIds.begin(), courseIds.end());
+	vector<const Course*> found;
+	catalog->SearchMany(lookups, found);
 
-void BinarySearchTree::inOrder(Node* node) {
-	if (node != nullptr) { //If node not empty
-		inOrder(node->left); //check left
-		DisplayNode(node); //print current
-		inOrder(node->right); //check right
+	for (size_t i = 0; i < courseIds.size(); ++i) {
+		const Course* course = found[i];
+		if (course == nullptr) {
+			result("find", courseIds[i], "error", "not found");
+			continue;
+		}
+		out.Write("find,");
+		out.Write(courseIds[i]);
+		out.Write(",ok,");
+		out.Write(course->courseName);
+		out.Put(',');
+		out.Write(course->preReq1);
+		out.Put(',');
+		out.Write(course->preReq2);
+		out.Put('\n');
 	}
+	courseIds.clear();
 }
 
 
 /*
- * DisplayNode() function called from inOrder() function
- * Purpose is to display courseId and courseName
+ * CatalogBenchmark times the catalog operations on synthetic catalogs and
+ * writes the results as JSON (in the same layout as Google Benchmark's
+ * --benchmark_format=json, so the usual comparison tools can read it).
+ * Run with --benchmark; --btree, --concurrent and --persistent pick the catalog as usual.
  *
- * @param Node node
+ * Catalogs are generated with IDs in one of three insertion orders:
+ *   sorted      - ascending IDs, the order of a typical catalog file
+ *   random      - shuffled IDs
+ *   adversarial - IDs sharing a 22 byte prefix (so CourseKey compares tie
+ *                 and fall back to the strings), inserted zigzag from both
+ *                 ends so the tree rebalances on nearly every insert
+ * Each course gets fanIn (0-2) prerequisites picked among the courses with
+ * smaller IDs, so every generated catalog is acyclic.
+ * With --concurrent the lookups are also timed from several reader threads
+ * at once, alone and next to a writer (see measureReaders()).
  */
-void BinarySearchTree::DisplayNode(Node* node) {
-	cout << node->course.courseId << ", " << node->course.courseName << endl;
-	return;
+class CatalogBenchmark {
+public:
+	enum class KeyOrder { Sorted, Random, Adversarial };
+
+	CatalogBenchmark(function<CourseCatalog*()> newCatalog, string catalogName, size_t maxCourses, unsigned fanIn);
+	bool Run(const string& outputFile);
+
+	static void GenerateCatalog(size_t count, KeyOrder order, unsigned fanIn, vector<Course>& courses);
+
+private:
+	static const size_t MIN_COURSES = 1000;
+	static const size_t MAX_LOOKUPS = 1000000; //Searches per iteration
+	static constexpr double MIN_SECONDS = 0.2;  //Each case repeats until it has run this long
+
+	struct Result {
+		string name;
+		size_t iterations;
+		double nanosPerOperation;
+		double operationsPerSecond;
+	};
+
+	function<CourseCatalog*()> newCatalog;
+	string catalogName;
+	size_t maxCourses;
+	unsigned fanIn;
+	vector<Result> results;
+
+	void measure(const string& name, const function<double(size_t& operations)>& iteration);
+	void runSize(size_t count, KeyOrder order);
+	void measureReaders(ConcurrentCourseTree& tree, const vector<string>& hits, const vector<Course>& courses, const string& suffix);
+	bool writeJson(const string& outputFile) const;
+	static const char* orderName(KeyOrder order);
+};
+
+CatalogBenchmark::CatalogBenchmark(function<CourseCatalog*()> newCatalog, string catalogName, size_t maxCourses, unsigned fanIn)
+	: newCatalog(move(newCatalog)), catalogName(move(catalogName)), maxCourses(maxCourses), fanIn(fanIn > 2 ? 2 : fanIn) {
+}
+
+const char* CatalogBenchmark::orderName(KeyOrder order) {
+	switch (order) {
+	case KeyOrder::Sorted: return "sorted";
+	case KeyOrder::Random: return "random";
+	default: return "adversarial";
+	}
 }
 
 /*
- * Search() function designed to take user input of courseId
- * called from menu option 3. Compares tree nodes for < or > value
- * And returns found node, or returns empty node if not found
+ * GenerateCatalog() fills courses with count synthetic courses in the
+ * insertion order described above. The same arguments always give the
+ * same catalog.
  *
- * @param string courseId
- * @return Course course
-*/
-Course BinarySearchTree::Search(string courseId) {
-	Node* currNode = root;
-
-	while (currNode != nullptr) { //Loop until end of tree
+ * @param size_t count, KeyOrder order, unsigned fanIn (0-2), vector<Course> courses
+ */
+void CatalogBenchmark::GenerateCatalog(size_t count, KeyOrder order, unsigned fanIn, vector<Course>& courses) {
+	mt19937_64 random(count * 31 + static_cast<size_t>(order));
+	const char* prefix = order == KeyOrder::Adversarial ? "CSCI-ELECTIVE-SEMINAR-" : "C";
+	auto courseId = [prefix](size_t index) {
+		string digits = to_string(index);
+		return prefix + string(digits.size() < 8 ? 8 - digits.size() : 0, '0') + digits;
+	};
 
-		//If match found, return match
-		if (currNode->course.courseId.compare(courseId) == 0) {
-			return currNode->course;
-		}
-		if (currNode->course.courseId.compare(courseId) > 0) { //search ID smaller than currnode ID
-			currNode = currNode->left; //traverse left
+	//Course i in ID order, prerequisites among courses 0..i-1
+	vector<Course> byId(count);
+	for (size_t i = 0; i < count; ++i) {
+		Course& aCourse = byId[i];
+		aCourse.courseId = courseId(i);
+		aCourse.courseName = "Course " + to_string(i);
+		if (i > 0 && fanIn > 0) {
+			size_t first = random() % i;
+			aCourse.preReq1 = courseId(first);
+			if (fanIn > 1 && i > 1) {
+				size_t second = random() % (i - 1);
+				aCourse.preReq2 = courseId(second >= first ? second + 1 : second);
+			}
 		}
-		else { //search ID larger than currnode ID
-			currNode = currNode->right;//traverse right
+	}
+
+	vector<size_t> sequence(count);
+	for (size_t i = 0; i < count; ++i) {
+		sequence[i] = i;
+	}
+	if (order == KeyOrder::Random) {
+		shuffle(sequence.begin(), sequence.end(), random);
+	}
+	else if (order == KeyOrder::Adversarial) { //0, n-1, 1, n-2, ...
+		for (size_t i = 0; i < count; ++i) {
+			sequence[i] = i % 2 == 0 ? i / 2 : count - 1 - i / 2;
 		}
 	}
-	//If not found, return empty course.
-	Course course;
-	return course;
+
+	courses.clear();
+	courses.reserve(count);
+	for (size_t index : sequence) {
+		courses.push_back(move(byId[index]));
+	}
 }
 
 /*
- *  courseDependencyCheck()
- *  This function serves as a dependency check. We don't want to delete lower level
- *  courses if they are required for higher level courses (a prerequisite to a higher course)
- *  so we must check to ensure that the course TO BE deleted is not a prerequisite for
- *  an existing course.
- *  **NOTE: This is part of the deleteCourse function, called from menu option 5.
- *          It has O(n) time complexity as it must check every node to see if
- *          there is a dependency for the course to be deleted.
- *  @param Node*, string courseId
- *  @return bool
+ * measure() repeats one benchmark case until it has run for MIN_SECONDS
+ * (at least once) and records the mean time per operation.
+ * iteration() does its own setup, returns the nanoseconds of its timed part
+ * and sets operations to the number of operations timed.
+ *
+ * @param string name, function iteration
  */
-bool BinarySearchTree::courseDependencyCheck(Node* node, string& courseId) {
-	if (node == nullptr) {
-		return false;
-	}
-
-	//Check prerequisites of current node
-	if ((node->course.preReq1 == courseId) || (node->course.preReq2 == courseId)) {
-		return true;
+void CatalogBenchmark::measure(const string& name, const function<double(size_t& operations)>& iteration) {
+	size_t iterations = 0;
+	size_t operations = 0;
+	double nanos = 0;
+	while (iterations == 0 || nanos < MIN_SECONDS * 1e9) {
+		size_t timed = 0;
+		cout.setstate(ios::failbit); //Catalog messages are not part of the result
+		nanos += iteration(timed);
+		cout.clear();
+		operations += timed;
+		++iterations;
 	}
 
-	//Recursively check tree for dependencies, traversing from left to right.
-	return courseDependencyCheck(node->left, courseId) || courseDependencyCheck(node->right, courseId);
+	Result result;
+	result.name = name;
+	result.iterations = iterations;
+	result.nanosPerOperation = operations == 0 ? 0 : nanos / operations;
+	result.operationsPerSecond = nanos == 0 ? 0 : operations * 1e9 / nanos;
+	results.push_back(result);
+	cout << "  " << name << ": " << result.nanosPerOperation << " ns/op, "
+		<< iterations << (iterations == 1 ? " iteration" : " iterations") << endl;
 }
 
 /*
- *  deleteNode()
- *  This function is designed to remove the node then will use a balancing algorithm
- *  to rebalance the AVL tree once the node is removed. To find the node to delete,
- *  the function will be recursively called passing the last node checked as the current
- *  node to check, traversing according to the courseId down the tree using comparisons.
- *  This function is called from DeleteNodeWithDependencyCheck() to ensure that it has
- *  no dependencies (it is not a prerequisite for another course).
- *  @params Node* node, string& courseId
- *  return node
+ * runSize() runs every case on one generated catalog
+ *
+ * @param size_t count, KeyOrder order
  */
-Node* BinarySearchTree::deleteNode(Node* node, string& courseId) {
-
-	if (node == nullptr) { //If node is empty
-		return nullptr; //node not found
-	}
+void CatalogBenchmark::runSize(size_t count, KeyOrder order) {
+	using Clock = chrono::steady_clock;
+	auto elapsed = [](Clock::time_point start) {
+		return static_cast<double>(chrono::duration_cast<chrono::nanoseconds>(Clock::now() - start).count());
+	};
+	string suffix = string("/") + orderName(order) + "/" + to_string(count);
 
-	//Traverse left if courseID is smaller
-	if (courseId < node->course.courseId) {
-		node->left = deleteNode(node->left, courseId);
-	}
+	vector<Course> courses;
+	GenerateCatalog(count, order, fanIn, courses);
 
-	//Traverse right if courseId is larger
-	else if (courseId > node->course.courseId) {
-		node->right = deleteNode(node->right, courseId);
+	//Parser load, from a csv file written in insertion order
+	string csvName = TemporaryFileName("benchmark_catalog.csv");
+	{
+		ofstream csv(csvName, ios::binary);
+		for (const Course& aCourse : courses) {
+			csv << aCourse.courseId << ',' << aCourse.courseName << ',' << aCourse.preReq1 << ',' << aCourse.preReq2 << '\n';
+		}
 	}
+	measure("ParserLoad" + suffix, [&](size_t& operations) {
+		unique_ptr<CourseCatalog> catalog(newCatalog());
+		Clock::time_point start = Clock::now();
+		Parser file(csvName, catalog.get());
+		double nanos = elapsed(start);
+		operations = catalog->Size();
+		return nanos;
+	});
+	remove(csvName.c_str());
 
-	/*
-	 *  This else statement shows the node has been found.
-	 *  To supplement the algorithm for user functionality
-	 *  implementing a successor change is required here
-	 *  but this will later be replaced when the AVL
-	 *  self balancing design is built, which will rotate the
-	 *  tree to keep it balanced. Currently, this algorithm
-	 *  will overtime unbalance the tree, but allow user delete
-	 *  functionality
-	 *  ##TODO implement balancing algorithm to replace successor algorithm.
-	 */
-	else { //node to delete is found
-
-		//Case 1, no children
-		if (node->left == nullptr && node->right == nullptr) {
-			delete node;
-			return nullptr;
+	measure("InsertCourse" + suffix, [&](size_t& operations) {
+		unique_ptr<CourseCatalog> catalog(newCatalog());
+		vector<Course> batch(courses);
+		Clock::time_point start = Clock::now();
+		for (Course& aCourse : batch) {
+			catalog->InsertCourse(move(aCourse));
 		}
+		double nanos = elapsed(start);
+		operations = batch.size();
+		return nanos;
+	});
 
-		//Case 2, one child
-		else if (node->left == nullptr) { //right child exists
-			Node* tempNode = node->right; //Grab the right child
-			delete node; //remove right's parent node
-			return tempNode; //replace deleted node with right node
+	//One loaded catalog for the read-only cases
+	unique_ptr<CourseCatalog> catalog(newCatalog());
+	{
+		vector<Course> batch(courses);
+		catalog->BulkLoad(batch);
+	}
+	vector<string> hits;
+	vector<string> misses;
+	mt19937_64 random(count);
+	size_t lookups = count < MAX_LOOKUPS ? count : MAX_LOOKUPS;
+	for (size_t i = 0; i < lookups; ++i) {
+		const Course& aCourse = courses[random() % count];
+		hits.push_back(aCourse.courseId);
+		misses.push_back(aCourse.courseId + "X"); //Sorts between two existing IDs
+	}
+	auto searchAll = [&](const vector<string>& courseIds, size_t& operations) {
+		size_t found = 0;
+		Clock::time_point start = Clock::now();
+		for (const string& courseId : courseIds) {
+			found += catalog->Search(courseId) != nullptr;
 		}
-		else if (node->right == nullptr) { //left child exists
-			Node* tempNode = node->left; //Grab left child
-			delete node; //remove left's parent node
-			return tempNode; //replace delted node with left node
+		double nanos = elapsed(start);
+		operations = courseIds.size();
+		if (found > courseIds.size()) { //Never true, keeps the searches from being optimized away
+			cout << found;
 		}
+		return nanos;
+	};
+	measure("SearchHit" + suffix, [&](size_t& operations) { return searchAll(hits, operations); });
+	measure("SearchMiss" + suffix, [&](size_t& operations) { return searchAll(misses, operations); });
+	ConcurrentCourseTree* concurrent = dynamic_cast<ConcurrentCourseTree*>(catalog.get());
+	if (concurrent != nullptr) {
+		measureReaders(*concurrent, hits, courses, suffix);
+	}
 
-		/*
-		 * Case 3, two children
-		 * This is a more complicated tree. A BST tree
-		 * uses branches, so if we have a parent node, a left is less than
-		 * a right is greater than, but we need the IMMEDIATE successor
-		 * (nearest higher value) to the parent node to replace it. To do this,
-		 * we find the smallest value of the right subtree. So, traverse right,
-		 * then traverse left until left is null pointer. This ensures we
-		 * have the immediate next value from the parent node, then we replace
-		 * that original parent node with the object from the smallest value of the
-		 * right subtree.
-		 */
-		else {
-			Node* successor = node->right; //branch into right subtree
-			while (successor->left != nullptr) { //traverses left from that node until nullptr
-				successor = successor->left; //keep moving left to find true successor
-			}
-
-			//Replaces the node found to delete with the successor course object
-			node->course = successor->course;
+	measure("InOrder" + suffix, [&](size_t& operations) {
+		MemorySink sink;
+		Clock::time_point start = Clock::now();
+		catalog->InOrder(sink);
+		sink.Flush();
+		double nanos = elapsed(start);
+		operations = catalog->Size();
+		return nanos;
+	});
+	catalog.reset();
 
-			/*
-			 * Since successor was copied to the node to delete, we must
-			 * delete the node so there are no duplicates. To do this, we recall
-			 * deleteNode on the node above the successor, and pass the successors id
-			 */
-			node->right = deleteNode(node->right, successor->course.courseId); //finds and deletes successor
-		}
+	//Every course deleted, dependents before their prerequisites
+	vector<string> deleteOrder;
+	deleteOrder.reserve(count);
+	for (const Course& aCourse : courses) {
+		deleteOrder.push_back(aCourse.courseId);
 	}
-	return node;
+	sort(deleteOrder.begin(), deleteOrder.end(), greater<string>());
+	measure("DeleteCourseWithDependencyCheck" + suffix, [&](size_t& operations) {
+		unique_ptr<CourseCatalog> catalog(newCatalog());
+		vector<Course> batch(courses);
+		catalog->BulkLoad(batch);
+		size_t deleted = 0;
+		Clock::time_point start = Clock::now();
+		for (const string& courseId : deleteOrder) {
+			deleted += catalog->DeleteCourseWithDependencyCheck(courseId);
+		}
+		double nanos = elapsed(start);
+		operations = deleted;
+		return nanos;
+	});
 }
 
 /*
- * DeleteCourseWithDependencyCheck()
- * This is the function that is called from main (option 5).
- * It is a wrapper class for isCourseDependency() (which checks to ensure
- * that the course to be deleted is not a prerquisite to another active
- * course in the tree) and deleteNode() which will recursively delete the node
- * if it exists in the tree and is safe to delete (not a dependency).
- * @param string courseId
- * @return boolean
+ * measureReaders() times the SearchHit lookups from several threads at
+ * once (one per core, 2 to 8), each lookup under its own EpochGuard as a
+ * reader thread would do it. SearchHitReaders leaves the tree alone;
+ * SearchHitReadersWriter has this thread replace courses until the readers
+ * finish, so every lookup races path copies and reclamation. Operations
+ * are the lookups of all readers, the writes are not counted.
+ *
+ * @param tree (loaded with courses), hits, courses, suffix
  */
-bool BinarySearchTree::DeleteCourseWithDependencyCheck(string courseId) {
-	Course userCourseToDelete = Search(courseId); //Find the course to delete
-
-	//if course to delete not found
-	if (userCourseToDelete.courseId.empty()) {
-		cout << "Error: " << courseId << " doesn't exist." << endl;
-		return false;
-	}
+void CatalogBenchmark::measureReaders(ConcurrentCourseTree& tree, const vector<string>& hits, const vector<Course>& courses, const string& suffix) {
+	using Clock = chrono::steady_clock;
+	unsigned readers = thread::hardware_concurrency();
+	readers = readers < 2 ? 2 : readers > 8 ? 8 : readers;
 
-	//if course to delete is a dependency
-	if (courseDependencyCheck(root, courseId)) {
-		cout << "Error: Can not delete " << courseId
-			<< ". It is a prerequisite to another course." << endl;
-		return false;
+	for (bool writing : { false, true }) {
+		string name = string(writing ? "SearchHitReadersWriter/" : "SearchHitReaders/") + to_string(readers) + suffix;
+		measure(name, [&](size_t& operations) {
+			atomic<size_t> found{ 0 };
+			atomic<unsigned> finished{ 0 };
+			vector<thread> workers;
+			Clock::time_point start = Clock::now();
+			for (unsigned r = 0; r < readers; ++r) {
+				workers.emplace_back([&, r]() {
+					size_t offset = r * hits.size() / readers; //Readers start at different IDs
+					size_t hitsFound = 0;
+					for (size_t i = 0; i < hits.size(); ++i) {
+						EpochGuard guard(tree.Epochs());
+						hitsFound += tree.Search(hits[(offset + i) % hits.size()], guard) != nullptr;
+					}
+					found += hitsFound;
+					++finished;
+				});
+			}
+			for (size_t next = 0; writing && finished.load() < readers; ++next) {
+				tree.InsertCourse(courses[next % courses.size()]);
+			}
+			for (thread& worker : workers) {
+				worker.join();
+			}
+			double nanos = static_cast<double>(chrono::duration_cast<chrono::nanoseconds>(Clock::now() - start).count());
+			operations = readers * hits.size();
+			if (found.load() > operations) { //Never true, keeps the searches from being optimized away
+				cout << found.load();
+			}
+			return nanos;
+		});
 	}
-
-	// delete node if found and if not a dependency
-	root = deleteNode(root, courseId);
-	cout << courseId << " has been successfully deleted." << endl;
-	return true;
-
-}
-
-class Parser {
-public:
-	Parser();
-	Parser(string fileName, BinarySearchTree* bst);
-	~Parser();
-
-
-};
-
-Parser::Parser() {
-
 }
 
-Parser::~Parser() {
-
-}
 /*
-* ParseLine used to parse a passed getline() from file reader
-*
-* @param newLine //from file
-* @return newLineTokens //newLine broken into vector
-*
-* REFERENCE:
-* https://stackoverflow.com/questions/5757721/use-getline-and-while-loop-to-split-a-string
-*
-*/
-vector<string> ParseLine(string newLine) {
-	char delim = ','; //Sets delimiter to check for
-	istringstream split(newLine); //allows split function to seperate newLine
-	vector<string> newLineTokens; //Vector stores each split element
-
-	//For loop that splits elements off after delim, attaches them to variable "each"
-	//and pushes them to back of vector
-	for (string each; getline(split, each, delim); newLineTokens.push_back(each));
-
-	return newLineTokens; //returns created vector
+ * Run() benchmarks catalogs of 1k, 10k, ... up to maxCourses courses in
+ * each key order, then writes the results to outputFile
+ *
+ * @param string outputFile
+ * @return bool false if outputFile could not be written
+ */
+bool CatalogBenchmark::Run(const string& outputFile) {
+	const KeyOrder orders[] = { KeyOrder::Sorted, KeyOrder::Random, KeyOrder::Adversarial };
+	for (size_t count = MIN_COURSES; count <= maxCourses; count *= 10) {
+		for (KeyOrder order : orders) {
+			cout << catalogName << ", " << count << " courses, " << orderName(order)
+				<< " order, fan-in " << fanIn << endl;
+			runSize(count, order);
+		}
+	}
+	return writeJson(outputFile);
 }
 
-
 /*
- * Parser() function that will read csv file line by line
- * and make function call to ParseLine() function, passing the line from
- * the file as argument to be split into a vector. The vector will be returned
- * and parted out into the Node STRUCT and then inserted into the BST
+ * writeJson() writes the results in Google Benchmark's JSON layout
  *
- *@param String fileName, BinarySearchTree bst
- *
-*/
-Parser::Parser(string fileName, BinarySearchTree* bst) {
-	int count = 0;
-	string line;                 //used to store string from getline
-	vector<string> lineToTokens; //used to parse a line into tokens
-	ifstream inputFile;          //file to be read
-	Course aCourse;              //declare structure object
-
-
-	inputFile.open(fileName);
-
-	if (inputFile.is_open()) { //only do while file is open
-
-		while (getline(inputFile, line)) { //reads each line until EOF, better solution than !.eof()
-			//REFERENCE: https://stackoverflow.com/questions/26071275/c-while-loop-and-getline-issue
+ * @param string outputFile
+ * @return bool false if outputFile could not be written
+ */
+bool CatalogBenchmark::writeJson(const string& outputFile) const {
+	ofstream json(outputFile);
+	if (!json.is_open()) {
+		return false;
+	}
 
-			//Sends the line to ParseLine() and returns a vector of separated strings to lineToTokens
-			lineToTokens = ParseLine(line);
+	char date[32];
+	time_t now = time(nullptr);
+	strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S", localtime(&now));
 
-			if (lineToTokens.size() < 2) { //Error format for vector too small (< 2)
-				cout << "Wrong format" << endl;
-			}
-			else {
-				aCourse.courseId = lineToTokens.at(0); //attaches first element to courseId
-				aCourse.courseName = lineToTokens.at(1); //attaches second elemnt to courseName
-				if (lineToTokens.size() > 2) { //if 3 elements exist in line
-					aCourse.preReq1 = lineToTokens.at(2); //attach 3rd element to preReq1
-					if (lineToTokens.size() > 3) { //if 4 elements exist in line
-						aCourse.preReq2 = lineToTokens.at(3); // attach 4th element to preReq2
-					}
-					else {
-						aCourse.preReq2 = ""; //Sets preReq2 to empty if doesn't exist
-					}
-				}
-				else {
-					//sets both preReq to empty if neither exist
-					aCourse.preReq1 = "";
-					aCourse.preReq2 = "";
-				}
-			}
-			bst->InsertCourse(aCourse); //insert each node into BST
-			++count; //Increment count for display menu message
-		}
-		cout << endl << count << " courses added to course list." << endl << endl; //display menu message
-	}
-	else { //Output file not open error message
-		cout << fileName + " is not open." << endl;
+	json << "{" << endl;
+	json << "  \"context\": {" << endl;
+	json << "    \"date\": \"" << date << "\"," << endl;
+	json << "    \"num_cpus\": " << thread::hardware_concurrency() << "," << endl;
+	json << "    \"catalog\": \"" << catalogName << "\"," << endl;
+	json << "    \"fan_in\": " << fanIn << "," << endl;
+	json << "    \"max_courses\": " << maxCourses << endl;
+	json << "  }," << endl;
+	json << "  \"benchmarks\": [" << endl;
+	for (size_t i = 0; i < results.size(); ++i) {
+		const Result& result = results[i];
+		json << "    {" << endl;
+		json << "      \"name\": \"" << result.name << "\"," << endl;
+		json << "      \"run_type\": \"iteration\"," << endl;
+		json << "      \"iterations\": " << result.iterations << "," << endl;
+		json << "      \"real_time\": " << result.nanosPerOperation << "," << endl;
+		json << "      \"time_unit\": \"ns\"," << endl;
+		json << "      \"items_per_second\": " << result.operationsPerSecond << endl;
+		json << "    }" << (i + 1 < results.size() ? "," : "") << endl;
 	}
-	inputFile.close();
+	json << "  ]" << endl;
+	json << "}" << endl;
+	return json.good();
 }
 
 
+const size_t COURSES_PER_PAGE = 20; //Courses per page of menu option 2
+const char* const STATS_FILE = "catalog_stats.json"; //Machine-readable copy of menu option 8
+
+//CatalogTests.cpp includes this file with COURSE_CATALOG_NO_MAIN defined and runs its own main()
+#ifndef COURSE_CATALOG_NO_MAIN
 int main(int argc, char* argv[]) {
 	string fileName;
 	string searchId; //Variable for user search string (also used for delete)
@@ -446,17 +7438,133 @@ int main(int argc, char* argv[]) {
 	string addPreReq1 = "";
 	string addPreReq2 = "";
 
-	switch (argc) { //Command prompt arg
-	case 2:
-		fileName = argv[1]; //Gets file as first argument
-		break;
-	default:
-		fileName = "ABCU_Advising_Program_Input.csv"; //hard coded file name as default
+	bool useBTree = false; //--btree selects the B-tree catalog instead of the BST
+	bool useConcurrent = false; //--concurrent selects the lock-free reader tree
+	bool usePersistent = false; //--persistent selects the versioned path-copying tree
+	bool runBenchmark = false; //--benchmark times the catalog instead of opening the menu
+	string benchmarkFile = "benchmark_results.json"; //--benchmark-out
+	size_t benchmarkMax = 1000000; //--benchmark-max, largest generated catalog
+	unsigned fanIn = 2; //--fan-in, prerequisites per generated course (0-2)
+	bool runBatch = false; //--batch runs a command script instead of opening the menu
+	string batchFile = "-"; //Script file, - for standard input
+	string logFile; //--log keeps an operation log so changes survive a restart
+
+	fileName = "ABCU_Advising_Program_Input.csv"; //hard coded file name as default
+	bool fileGiven = false; //A batch run only loads fileName if it was named
+	for (int i = 1; i < argc; ++i) { //Command prompt args
+		string arg = argv[i];
+		if (arg == "--btree") {
+			useBTree = true;
+		}
+		else if (arg == "--concurrent") {
+			useConcurrent = true;
+		}
+		else if (arg == "--persistent") {
+			usePersistent = true;
+		}
+		else if (arg == "--batch") {
+			runBatch = true;
+			if (i + 1 < argc) {
+				batchFile = argv[++i];
+			}
+		}
+		else if (arg == "--log" && i + 1 < argc) {
+			logFile = argv[++i];
+		}
+		else if (arg == "--benchmark") {
+			runBenchmark = true;
+		}
+		else if (arg == "--benchmark-out" && i + 1 < argc) {
+			benchmarkFile = argv[++i];
+		}
+		else if (arg == "--benchmark-max" && i + 1 < argc) {
+			benchmarkMax = strtoull(argv[++i], nullptr, 10);
+		}
+		else if (arg == "--fan-in" && i + 1 < argc) {
+			fanIn = static_cast<unsigned>(strtoul(argv[++i], nullptr, 10));
+		}
+		else {
+			fileName = arg; //Gets file as argument
+			fileGiven = true;
+		}
+	}
+
+	//Construct BST (or B-tree, concurrent or persistent tree)
+	auto newCatalog = [useBTree, useConcurrent, usePersistent]() -> CourseCatalog* {
+		if (useBTree) {
+			return new CourseBTree();
+		}
+		if (useConcurrent) {
+			return new ConcurrentCourseTree();
+		}
+		if (usePersistent) {
+			return new PersistentCourseTree();
+		}
+		return new BinarySearchTree();
+	};
+
+	if (runBenchmark) {
+		const char* catalogName = useBTree ? "btree" : useConcurrent ? "concurrent" : usePersistent ? "persistent" : "bst";
+		CatalogBenchmark benchmark(newCatalog, catalogName, benchmarkMax, fanIn);
+		if (!benchmark.Run(benchmarkFile)) {
+			cout << benchmarkFile << " is not open." << endl;
+			return 1;
+		}
+		cout << "Results written to " << benchmarkFile << endl;
+		return 0;
+	}
 
+	CourseCatalog* bst = newCatalog();
+	if (!logFile.empty()) { //Load the course file (or compacted base) and replay the changes made since
+		LoggedCatalog* logged = new LoggedCatalog(bst, logFile);
+		if (runBatch) { //Batch output is only the results
+			cout.setstate(ios::failbit);
+		}
+		bool recovered = logged->Recover(fileName);
+		cout.clear();
+		if (!recovered) {
+			if (runBatch) {
+				cout << "Error: " << logFile << " could not be replayed." << endl;
+			}
+			delete logged;
+			return 1;
+		}
+		bst = logged;
 	}
 
-	BinarySearchTree* bst = new BinarySearchTree(); //Construct BST
-	Course course;
+	if (runBatch) {
+		if (logFile.empty() && fileGiven) { //Recover() already loaded it with --log
+			if (!MappedFile().Open(fileName)) {
+				cout << fileName + " is not open." << endl;
+				delete bst;
+				return 1;
+			}
+			cout.setstate(ios::failbit); //Batch output is only the results
+			bst->LoadFile(fileName);
+			cout.clear();
+		}
+		size_t invalid;
+		FileSink results(1); //Standard output
+		if (batchFile == "-") {
+			string script((istreambuf_iterator<char>(cin)), istreambuf_iterator<char>());
+			BatchRunner runner(bst, results);
+			invalid = runner.Run(script.data(), script.data() + script.size());
+		}
+		else {
+			MappedFile script;
+			if (!script.Open(batchFile)) {
+				cout << batchFile + " is not open." << endl;
+				delete bst;
+				return 1;
+			}
+			BatchRunner runner(bst, results);
+			invalid = runner.Run(script.Data(), script.Data() + script.Size());
+		}
+		results.Flush();
+		delete bst;
+		return invalid == 0 ? 0 : 1;
+	}
+	const Course* course; //Search result, points into the tree
 
 
 	choice = 0;
@@ -475,20 +7583,52 @@ int main(int argc, char* argv[]) {
 		// Added enhancement 4 & 5 for Add and Delete course
 		cout << "  4: Add Course." << endl;
 		cout << "  5: Delete Course by ID." << endl;
+		cout << "  6: Save Catalog Snapshot." << endl;
+		cout << "  7: Print Course Order." << endl;
+		cout << "  8: Print Catalog Statistics." << endl;
 		cout << "  9: Exit Program" << endl << endl;
 		cout << "Enter Choice: ";
 		cin >> choice; //captures users menu choice
 
 		switch (choice) {
 		case 1: { //"Load Courses File"
-			Parser file = Parser(fileName, bst); //Reads file and loads tree
+			bst->LoadFile(fileName); //Reads file and loads tree
+			bst->Commit(); //Logged with --log
 			break;
 		}
-		case 2: //"Print Course List."
+		case 2: { //"Print Course List."
+			//Whole list, or one page of it so a large catalog does not scroll past
+			size_t pageCount = (bst->Size() + COURSES_PER_PAGE - 1) / COURSES_PER_PAGE;
+			size_t page = 0; //An empty catalog has no pages to ask for
+			if (pageCount > 0) {
+				cout << "Enter page to print (1-" << pageCount << ") or 0 for the whole list: ";
+				while (!(cin >> page) || page > pageCount) {
+					if (cin.eof()) { //No more input, print the whole list
+						page = 0;
+						break;
+					}
+					//clears input line to prevent infinite loop from character entry (up to 10K characters)
+					cin.clear();
+					cin.ignore(10000, '\n');
+					cout << "Please enter a page from 1 to " << pageCount << ", or 0 for the whole list: ";
+				}
+			}
+
 			cout << endl << "------ Current Course List ------" << endl << endl; //Visual list header
-			bst->InOrder(); //Prints BST in alphabetical order
+			FileSink console(1); //Standard output, written in large blocks
+			if (page == 0) {
+				bst->InOrder(console); //Prints BST in alphabetical order
+			}
+			else {
+				bst->InOrderPage((page - 1) * COURSES_PER_PAGE, COURSES_PER_PAGE, console);
+			}
+			console.Flush(); //Before cout writes again
+			if (page != 0) {
+				cout << endl << "Page " << page << " of " << pageCount;
+			}
 			cout << endl;
 			break;
+		}
 
 		case 3: { //"Find & Print Course."
 			cout << "Enter course to find: ";
@@ -503,18 +7643,29 @@ int main(int argc, char* argv[]) {
 			course = bst->Search(searchId);
 
 
-			if (!course.courseId.empty()) { //ID found
-				cout << endl << course.courseId << ", " << course.courseName << endl; //Displays ID and Name
-				if (!course.preReq1.empty()) { //If preReq1 exists
-					cout << "Prerequisites: " << course.preReq1; //Prints prerequisites
-					if (!course.preReq2.empty()) { //If preReq2 exists
-						cout << ", " << course.preReq2; //Adds to print prerequisites
+			if (course != nullptr) { //ID found
+				cout << endl << course->courseId << ", " << course->courseName << endl; //Displays ID and Name
+				if (!course->preReq1.empty()) { //If preReq1 exists
+					cout << "Prerequisites: " << course->preReq1; //Prints prerequisites
+					if (!course->preReq2.empty()) { //If preReq2 exists
+						cout << ", " << course->preReq2; //Adds to print prerequisites
 					}
 					cout << endl;
 				}
 				else { //If no prerequisites in course info
 					cout << "Prerequisites: None" << endl;
 				}
+
+				//Prerequisites of the prerequisites too, from the graph's cached closure
+				vector<string> allPreReqs;
+				bst->Prerequisites().TransitivePrerequisites(course->courseId, allPreReqs);
+				if (!allPreReqs.empty()) {
+					cout << "All prerequisites: ";
+					for (size_t i = 0; i < allPreReqs.size(); ++i) {
+						cout << (i == 0 ? "" : ", ") << allPreReqs[i];
+					}
+					cout << endl;
+				}
 				cout << endl;
 			}
 			else { //ID not found
@@ -555,7 +7706,7 @@ int main(int argc, char* argv[]) {
 				//Check to ensure that the prerequisite ID exists in the tree
 				//If the prerequisite does not exist as a full course object
 				//the prerequisite should be denied until the course is added first.
-				if (bst->Search(addPreReq1).courseId.empty()) {
+				if (bst->Search(addPreReq1) == nullptr) {
 					cout << "Error: Prerequisite 1 ID does not exist: " << endl;
 					cout << "In order to add this course, prerequisite 2 must exist in the tree." << endl;
 					cout << "Please add the prerequisite as a course first before continuing" << endl;
@@ -574,7 +7725,7 @@ int main(int argc, char* argv[]) {
 				}
 
 				//Check to ensure Prerequisite ID exists in the tree.
-				if (bst->Search(addPreReq2).courseId.empty()) {
+				if (bst->Search(addPreReq2) == nullptr) {
 					cout << "Error: Prerequisite 2 ID does not exist: " << endl;
 					cout << "In order to add this course, prerequisite 2 must exist in the tree." << endl;
 					cout << "Please add the prerequisite as a course first before continuing" << endl;
@@ -589,9 +7740,11 @@ int main(int argc, char* argv[]) {
 			aCourse.preReq1 = addPreReq1;
 			aCourse.preReq2 = addPreReq2;
 
-			//add course to the tree
-			bst->InsertCourse(aCourse);
-			cout << addCourseID << " successfully added." << endl;
+			//add course to the tree, refused if it would close a prerequisite cycle
+			if (bst->InsertCourse(move(aCourse))) {
+				bst->Commit(); //Durable before it is reported, with --log
+				cout << addCourseID << " successfully added." << endl;
+			}
 			break;
 		}
 
@@ -614,36 +7767,87 @@ int main(int argc, char* argv[]) {
 			}
 
 			/*
-			 * ##FIXME: Unfortunately, if we want to check the prerequisites to make sure
-			 *  we are not deleting a course that is a prequisite to another course, another
-			 *  structure must be designed called a reverse index, which maps prerequisites
-			 *  to higher courses (as their dependencies). This structure can help prevent
-			 *  deletion of courses that are required to be taken before other courses that
-			 *  will STILL exists in the tree. The problem here is that comparing the
-			 *  deleteCourseID to every single preReq1 and preReq2 of every single node
-			 *  reduces the time complexity of the delete function to O(log n + n) = O(n)
-			 *  This doesnt strictly defeat the purpose of creating an AVL tree, but it
-			 *  increases the time complexity making it less efficient with a delete function
-			 *  that checks to ensure the course being deleted is not a dependency of a course
-			 *  that still exists. I'm finding it difficult to design this dependency check
-			 *  using a reverse index, as the structure is unclear to me in my research.
-			 *
-			 *  ##FOR NOW: I am going to implement the O(n) dependency check method
-			 *  to prevent dependency deletion until I can find a better way to implement this.
-			 *
-			 *  ##FUTURE REFERENCE: Inverse/reverse indexing will provide a time complexity for
-			 *  Deletion to be O(log n + k) where k is ONLY the number of dependencies, not the
-			 *  entire tree. (for example, CS101 is the prerequisite for CS201 and CS245 which will
-			 *  be portrayed as: [CS101] | {CS201, CS245} which shows 101 must exist if 201 and 245 exist).
-			 *
+			 * The dependency check uses the dependents in the prerequisite graph,
+			 * which maps prerequisites to higher courses (as their dependencies),
+			 * e.g. [CS101] | {CS201, CS245} shows 101 must exist if 201 and 245 exist.
+			 * Deletion is O(log n + k) where k is ONLY the number of dependencies,
+			 * not the entire tree.
 			 */
 
-			bst->DeleteCourseWithDependencyCheck(deleteCourseID);
+			if (!bst->DeleteCourseWithDependencyCheck(deleteCourseID) && bst->Prerequisites().IsPrerequisite(deleteCourseID)) {
+				//Offer to retire the course together with every course that depends on it
+				vector<string> closure;
+				bst->Prerequisites().DependentClosure({ deleteCourseID }, closure);
+				cout << "Delete " << deleteCourseID << " and the " << closure.size() - 1
+					<< " courses that depend on it? (Y/N): ";
+				string answer;
+				cin >> answer;
+				if (!answer.empty() && toupper(answer[0]) == 'Y') {
+					vector<string> removed;
+					bst->DeleteCascade({ deleteCourseID }, removed);
+					for (const string& courseId : removed) {
+						cout << courseId << " has been successfully deleted." << endl;
+					}
+				}
+				cout << endl;
+			}
+			bst->Commit(); //Logged with --log, once for a delete or a whole cascade
+			break;
+		}
+
+
+
+
+		case 6: { //Save Catalog Snapshot
+			//Snapshot can be reopened later with option 1 or as the program argument
+			string snapshotFile;
+			cout << "Enter snapshot file name: ";
+			cin >> snapshotFile;
+
+			if (CatalogSnapshot::Save(*bst, snapshotFile)) {
+				cout << endl << bst->Size() << " courses saved to " << snapshotFile << "." << endl << endl;
+			}
+			else {
+				cout << endl << "Error: could not write " << snapshotFile << "." << endl << endl;
+			}
 			break;
 		}
 
+		case 7: { //Print Course Order
+			//Every course after all of its prerequisites, e.g. for planning a degree
+			vector<string> order;
+			bool acyclic = bst->Prerequisites().TopologicalOrder(order);
+
+			cout << endl << "------ Course Order ------" << endl << endl;
+			FileSink console(1);
+			for (const string& courseId : order) {
+				console.Write(courseId);
+				console.Put('\n');
+			}
+			console.Flush();
+			if (!acyclic) {
+				cout << "Warning: some courses are on a prerequisite cycle and are not listed." << endl;
+			}
+			cout << endl;
+			break;
+		}
 
+		case 8: { //Print Catalog Statistics
+			//Tree shape and hot-path counters, to tell why a catalog is slow
+			TreeShape shape;
+			bst->Shape(shape);
 
+			cout << endl << "------ Catalog Statistics ------" << endl << endl;
+			catalogStats.Print(cout, shape);
+			if (catalogStats.WriteJson(STATS_FILE, shape)) {
+				cout << "Statistics written to " << STATS_FILE << endl;
+			}
+			else {
+				cout << STATS_FILE << " is not open." << endl;
+			}
+			cout << endl;
+			break;
+		}
 
 		case 9: //"Exit Program."
 			cout << "Thank you for using ABC University Course Finder Program." << endl;
@@ -659,6 +7863,8 @@ int main(int argc, char* argv[]) {
 		}
 
 	}
+	delete bst; //Frees the tree and all of its nodes
 	return 0;
 	//END main
-}
\ No newline at end of file
+}
+#endif
\ No newline at end of file
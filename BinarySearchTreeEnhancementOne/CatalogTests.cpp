@@ -0,0 +1,822 @@
+//=================================================
+//  Name: CatalogTests
+//  Description: Tests for the course catalogs of
+//  BinarySearchTreeEnhancementOne.cpp. Each test drives a
+//  catalog through inserts, deletes and loads, checking its
+//  structural invariants (Verify()) after every step, and the
+//  file formats are checked by round trips. Exits with 1 if
+//  any check fails.
+//=================================================
+
+#define COURSE_CATALOG_NO_MAIN
+#include "BinarySearchTreeEnhancementOne.cpp"
+
+size_t checksRun = 0;
+size_t checksFailed = 0;
+
+//Records one check, reporting the test, line and condition if it fails
+#define CHECK(condition) check((condition), #condition, __FILE__, __LINE__)
+
+void check(bool passed, const char* condition, const char* file, int line) {
+	++checksRun;
+	if (!passed) {
+		++checksFailed;
+		cerr << file << ":" << line << ": check failed: " << condition << endl;
+	}
+}
+
+//Checks the invariants of catalog and its prerequisite graph, reporting what is broken
+#define CHECK_VALID(catalog) checkValid((catalog), #catalog, __FILE__, __LINE__)
+
+void checkValid(CourseCatalog& catalog, const char* name, const char* file, int line) {
+	string problem;
+	bool valid = catalog.Verify(problem) && catalog.Prerequisites().Verify(problem);
+	check(valid, name, file, line);
+	if (!valid) {
+		cerr << "  " << problem << endl;
+	}
+}
+
+//Builds a course, prerequisites optional
+Course MakeCourse(const string& courseId, const string& preReq1 = "", const string& preReq2 = "") {
+	Course aCourse;
+	aCourse.courseId = courseId;
+	aCourse.courseName = "Course " + courseId;
+	aCourse.preReq1 = preReq1;
+	aCourse.preReq2 = preReq2;
+	return aCourse;
+}
+
+//One empty catalog of every kind
+vector<unique_ptr<CourseCatalog>> AllCatalogs() {
+	vector<unique_ptr<CourseCatalog>> catalogs;
+	catalogs.emplace_back(new BinarySearchTree());
+	catalogs.emplace_back(new CourseBTree());
+	catalogs.emplace_back(new ConcurrentCourseTree());
+	catalogs.emplace_back(new PersistentCourseTree());
+	return catalogs;
+}
+
+//Every course of catalog as one "id,name,preReq1,preReq2" line each, for comparing catalogs
+string Contents(const CourseCatalog& catalog) {
+	vector<const Course*> sorted;
+	catalog.CollectCourses(sorted);
+	string contents;
+	for (const Course* course : sorted) {
+		contents += course->courseId + "," + course->courseName + "," + course->preReq1 + "," + course->preReq2 + "\n";
+	}
+	return contents;
+}
+
+//Course ID number i, zero padded so IDs sort like their numbers
+string CourseId(size_t i) {
+	string digits = to_string(i);
+	return "C" + string(digits.size() < 6 ? 6 - digits.size() : 0, '0') + digits;
+}
+
+/*
+ * Inserts in ascending, descending and shuffled order, then deletes in
+ * shuffled order, verifying the AVL invariants after every change
+ */
+void TestAvlInsertDelete() {
+	const size_t COURSES = 300;
+	vector<size_t> ascending(COURSES);
+	for (size_t i = 0; i < COURSES; ++i) {
+		ascending[i] = i;
+	}
+	vector<size_t> descending(ascending.rbegin(), ascending.rend());
+	vector<size_t> shuffled(ascending);
+	shuffle(shuffled.begin(), shuffled.end(), mt19937_64(1));
+
+	for (const vector<size_t>* order : { &ascending, &descending, &shuffled }) {
+		BinarySearchTree tree;
+		for (size_t i : *order) {
+			CHECK(tree.InsertCourse(MakeCourse(CourseId(i))));
+			CHECK_VALID(tree);
+		}
+		CHECK(tree.Size() == COURSES);
+		TreeShape shape;
+		tree.Shape(shape);
+		CHECK(shape.Height() <= 12); //1.44 log2(300) for AVL
+
+		vector<size_t> deletes(*order);
+		shuffle(deletes.begin(), deletes.end(), mt19937_64(2));
+		for (size_t n = 0; n < deletes.size(); ++n) {
+			CHECK(tree.DeleteCourseWithDependencyCheck(CourseId(deletes[n])));
+			CHECK(tree.Search(CourseId(deletes[n])) == nullptr);
+			CHECK_VALID(tree);
+		}
+		CHECK(tree.Size() == 0);
+	}
+}
+
+/*
+ * Replacing a course keeps one node, and rank/select/iteration agree with
+ * the sorted order
+ */
+void TestAvlOrderStatistics() {
+	BinarySearchTree tree;
+	for (size_t i = 0; i < 100; i += 2) {
+		tree.InsertCourse(MakeCourse(CourseId(i)));
+	}
+	Course replacement = MakeCourse(CourseId(10));
+	replacement.courseName = "Replaced";
+	CHECK(tree.InsertCourse(replacement));
+	CHECK(tree.Size() == 50);
+	CHECK(tree.Search(CourseId(10))->courseName == "Replaced");
+	CHECK_VALID(tree);
+
+	CHECK(tree.Rank(CourseId(10)) == 5);
+	CHECK(tree.Rank(CourseId(11)) == 6);
+	CHECK(tree.Select(5)->courseId == CourseId(10));
+	CHECK(tree.Select(50) == nullptr);
+	CHECK(tree.CountInRange(CourseId(10), CourseId(20)) == 6);
+
+	size_t position = 0;
+	for (const Course& aCourse : tree) {
+		CHECK(aCourse.courseId == CourseId(position * 2));
+		++position;
+	}
+	CHECK(position == 50);
+}
+
+/*
+ * A course still listed as a prerequisite is not deleted
+ */
+void TestDependencyCheck() {
+	BinarySearchTree tree;
+	tree.InsertCourse(MakeCourse("CSCI100"));
+	tree.InsertCourse(MakeCourse("CSCI200", "CSCI100"));
+	CHECK(!tree.DeleteCourseWithDependencyCheck("CSCI100"));
+	CHECK(tree.DeleteCourseWithDependencyCheck("CSCI200"));
+	CHECK(tree.DeleteCourseWithDependencyCheck("CSCI100"));
+	CHECK(!tree.DeleteCourseWithDependencyCheck("CSCI100"));
+	CHECK_VALID(tree);
+}
+
+/*
+ * A repeated ID in a bulk load ends up as repeated InsertCourse() calls (in
+ * course ID order) would leave it: when the last occurrence is refused for
+ * a cycle, the last accepted one is kept instead of losing the row
+ */
+void TestBulkLoadDuplicates() {
+	vector<Course> base = { MakeCourse("CSCI100"), MakeCourse("CSCI200", "CSCI100"), MakeCourse("MATH100", "CSCI200") };
+	vector<Course> batch;
+	batch.push_back(MakeCourse("CSCI300", "CSCI200"));
+	batch.push_back(MakeCourse("CSCI100"));
+	batch.back().courseName = "Kept";
+	batch.push_back(MakeCourse("CSCI100", "MATH100")); //Would close CSCI100 -> MATH100 -> CSCI200 -> CSCI100
+	batch.push_back(MakeCourse("CSCI300"));
+	batch.push_back(MakeCourse("CSCI100", "CSCI200")); //So would this one
+
+	for (unique_ptr<CourseCatalog>& catalog : AllCatalogs()) {
+		BinarySearchTree reference;
+		vector<Course> sorted(batch);
+		stable_sort(sorted.begin(), sorted.end(), [](const Course& a, const Course& b) { return a.courseId < b.courseId; });
+		for (const Course& aCourse : base) {
+			reference.InsertCourse(aCourse);
+		}
+		for (const Course& aCourse : sorted) {
+			reference.InsertCourse(aCourse);
+		}
+
+		vector<Course> copy(base);
+		catalog->BulkLoad(copy);
+		copy = batch;
+		catalog->BulkLoad(copy);
+		CHECK(Contents(*catalog) == Contents(reference));
+		CHECK(catalog->Search("CSCI100") != nullptr && catalog->Search("CSCI100")->courseName == "Kept");
+		CHECK(catalog->Search("CSCI300") != nullptr && catalog->Search("CSCI300")->preReq1.empty());
+		CHECK_VALID(*catalog);
+
+		//Every occurrence refused, the stored course stays
+		vector<Course> refused = { MakeCourse("CSCI100", "MATH100"), MakeCourse("CSCI100", "CSCI200") };
+		catalog->BulkLoad(refused);
+		CHECK(catalog->Search("CSCI100") != nullptr && catalog->Search("CSCI100")->courseName == "Kept");
+		CHECK(catalog->Size() == 4);
+		CHECK_VALID(*catalog);
+	}
+}
+
+/*
+ * Inserts enough courses for several levels of splits, then deletes them
+ * all so every borrow and merge case of the B-tree runs, verifying the node
+ * occupancy and leaf depth after every change. IDs over 16 bytes share
+ * packed keys and take the string comparison path.
+ */
+void TestBTreeSplitMerge() {
+	const size_t COURSES = 1200;
+	for (const char* prefix : { "", "LONGDEPARTMENTNAME" }) {
+		vector<string> ids;
+		for (size_t i = 0; i < COURSES; ++i) {
+			ids.push_back(prefix + CourseId(i));
+		}
+		vector<string> shuffled(ids);
+		shuffle(shuffled.begin(), shuffled.end(), mt19937_64(3));
+
+		for (const vector<string>* order : { &ids, &shuffled }) {
+			CourseBTree tree;
+			for (const string& courseId : *order) {
+				CHECK(tree.InsertCourse(MakeCourse(courseId)));
+				CHECK_VALID(tree);
+			}
+			TreeShape shape;
+			tree.Shape(shape);
+			CHECK(shape.Height() >= 3);
+
+			vector<string> deletes(*order);
+			shuffle(deletes.begin(), deletes.end(), mt19937_64(4));
+			for (const string& courseId : deletes) {
+				CHECK(tree.DeleteCourseWithDependencyCheck(courseId));
+				CHECK(tree.Search(courseId) == nullptr);
+				CHECK_VALID(tree);
+			}
+			CHECK(tree.Size() == 0);
+		}
+
+		//A bulk-built tree packs its nodes, so deletes from it start merging at once
+		CourseBTree tree;
+		vector<Course> courses;
+		for (const string& courseId : shuffled) {
+			courses.push_back(MakeCourse(courseId));
+		}
+		tree.BulkLoad(courses);
+		CHECK(tree.Size() == COURSES);
+		CHECK_VALID(tree);
+		for (size_t i = 0; i < COURSES; i += 2) {
+			CHECK(tree.DeleteCourseWithDependencyCheck(ids[i]));
+			CHECK_VALID(tree);
+		}
+		CHECK(tree.Size() == COURSES / 2);
+	}
+}
+
+/*
+ * A snapshot saved from each catalog loads into every kind of catalog with
+ * the same courses and a working prerequisite graph: dependency checks,
+ * cycle refusal and the topological order all see the stored edges,
+ * including prerequisites outside the catalog. A damaged snapshot is
+ * rejected, and a snapshot loaded on top of courses merges like BulkLoad().
+ */
+void TestSnapshotRoundTrip() {
+	vector<Course> courses;
+	for (size_t i = 0; i < 200; ++i) {
+		string preReq1 = i >= 3 ? CourseId(i / 3) : "";
+		string preReq2 = i % 7 == 0 ? "MATH" + to_string(i % 5) : i >= 10 ? CourseId(i - 10) : ""; //MATH courses are not in the catalog
+		courses.push_back(MakeCourse(CourseId(i), preReq1, preReq2));
+	}
+	courses.push_back(MakeCourse("PHYS100", "C000001", "C000001"));
+	string fileName = TemporaryFileName("roundtrip.snapshot");
+
+	for (unique_ptr<CourseCatalog>& source : AllCatalogs()) {
+		vector<Course> copy(courses);
+		source->BulkLoad(copy);
+		CHECK(CatalogSnapshot::Save(*source, fileName));
+		CHECK(!ifstream(fileName + ".tmp").is_open());
+
+		for (unique_ptr<CourseCatalog>& loaded : AllCatalogs()) {
+			Parser load(fileName, loaded.get());
+			CHECK(Contents(*loaded) == Contents(*source));
+			CHECK_VALID(*loaded);
+
+			PrerequisiteGraph& graph = loaded->Prerequisites();
+			CHECK(graph.IsPrerequisite("C000001"));
+			CHECK(!graph.IsPrerequisite("C000199"));
+			vector<string> order;
+			CHECK(graph.TopologicalOrder(order));
+			CHECK(order.size() == courses.size());
+			CHECK(graph.DependsOn("C000100", "C000011"));
+			CHECK(!graph.DependsOn("C000011", "C000100"));
+
+			//Edges into the loaded courses still refuse cycles and accept the rest
+			CHECK(!loaded->InsertCourse(MakeCourse("C000001", "C000100")));
+			CHECK(!loaded->InsertCourse(MakeCourse("MATH0", "C000000"))); //C000000 lists MATH0
+			CHECK(loaded->InsertCourse(MakeCourse("C000150", "C000001")));
+			CHECK(!loaded->DeleteCourseWithDependencyCheck("C000001"));
+			CHECK(loaded->DeleteCourseWithDependencyCheck("PHYS100"));
+			CHECK_VALID(*loaded);
+
+			//Loaded on top of what is there, the snapshot merges and replaces
+			Parser reload(fileName, loaded.get());
+			CHECK(Contents(*loaded) == Contents(*source));
+			CHECK_VALID(*loaded);
+		}
+	}
+
+	//A flipped byte fails the checksum and nothing is loaded
+	{
+		ifstream in(fileName, ios::binary);
+		string bytes((istreambuf_iterator<char>(in)), istreambuf_iterator<char>());
+		vector<Course> loaded;
+		vector<int64_t> preReqIndex;
+		CHECK(CatalogSnapshot::Load(bytes.data(), bytes.size(), loaded, preReqIndex));
+		CHECK(loaded.size() == courses.size() && preReqIndex.size() == 2 * courses.size());
+		bytes[bytes.size() / 2] ^= 0x20;
+		CHECK(!CatalogSnapshot::Load(bytes.data(), bytes.size(), loaded, preReqIndex));
+		CHECK(!CatalogSnapshot::Load(bytes.data(), bytes.size() - 8, loaded, preReqIndex));
+	}
+
+	//The same high bit flipped in two words of the string pool (course names,
+	//which nothing but the checksum covers) must not cancel out
+	{
+		ifstream in(fileName, ios::binary);
+		string bytes((istreambuf_iterator<char>(in)), istreambuf_iterator<char>());
+		CatalogSnapshot::SnapshotHeader header;
+		memcpy(&header, bytes.data(), sizeof(header));
+		size_t pool = bytes.size() - header.poolBytes;
+		vector<Course> loaded;
+		vector<int64_t> preReqIndex;
+		for (size_t words : { 1, 2 }) { //Within the first course name and prerequisite
+			string flipped(bytes);
+			flipped[pool + 7] ^= '\x80';
+			flipped[pool + 8 * words + 7] ^= '\x80';
+			CHECK(!CatalogSnapshot::Load(flipped.data(), flipped.size(), loaded, preReqIndex));
+		}
+	}
+	remove(fileName.c_str());
+}
+
+/*
+ * Reader threads search a ConcurrentCourseTree under their own guards while
+ * the main thread replaces and deletes courses. Courses a reader found stay
+ * readable until its guard ends, however many versions were retired
+ * meanwhile (the address sanitizer build catches an early free), and every
+ * lookup returns the course it asked for.
+ */
+void TestConcurrentReaders() {
+	const size_t COURSES = 500;
+	const size_t READERS = 4;
+	ConcurrentCourseTree tree;
+	for (size_t i = 0; i < COURSES; ++i) {
+		tree.InsertCourse(MakeCourse(CourseId(i)));
+	}
+
+	atomic<bool> done{ false };
+	atomic<size_t> wrong{ 0 };
+	atomic<size_t> held{ 0 };
+	vector<thread> readers;
+	for (size_t r = 0; r < READERS; ++r) {
+		readers.emplace_back([&tree, &done, &wrong, &held, r]() {
+			mt19937_64 random(r);
+			while (!done.load()) {
+				EpochGuard guard(tree.Epochs());
+				vector<const Course*> found;
+				for (int n = 0; n < 32; ++n) {
+					string courseId = CourseId(random() % COURSES);
+					const Course* course = tree.Search(courseId, guard);
+					if (course != nullptr) {
+						found.push_back(course);
+						wrong += course->courseId == courseId ? 0 : 1;
+					}
+				}
+				this_thread::yield(); //Let the writer retire what the guard still holds
+				for (const Course* course : found) {
+					wrong += course->courseName.empty() ? 1 : 0;
+				}
+				held += found.size();
+			}
+		});
+	}
+
+	mt19937_64 random(99);
+	for (size_t round = 0; round < 20000; ++round) {
+		size_t i = random() % COURSES;
+		Course aCourse = MakeCourse(CourseId(i));
+		aCourse.courseName = "Version " + to_string(round);
+		if (round % 3 == 1) {
+			tree.DeleteCourseWithDependencyCheck(aCourse.courseId);
+		}
+		else {
+			tree.InsertCourse(aCourse);
+		}
+	}
+	done = true;
+	for (thread& reader : readers) {
+		reader.join();
+	}
+	CHECK(wrong.load() == 0);
+	CHECK(held.load() > 0);
+	CHECK_VALID(tree);
+}
+
+/*
+ * Random inserts, replacements, deletes, loads and cascades on a
+ * PersistentCourseTree, keeping a snapshot of every version. Each snapshot
+ * must still list exactly what the tree held when it was taken, Version()
+ * must find only the last VERSION_HISTORY versions, and the leak checker of
+ * the sanitizer build catches a reference that is never dropped.
+ */
+void TestPersistentVersions() {
+	const size_t IDS = 200;
+	PersistentCourseTree tree;
+	auto listing = [](const CatalogVersion& version) {
+		vector<const Course*> sorted;
+		version.CollectCourses(sorted);
+		string contents;
+		for (const Course* course : sorted) {
+			contents += course->courseId + "," + course->courseName + "," + course->preReq1 + "," + course->preReq2 + "\n";
+		}
+		return contents;
+	}; //Same lines as Contents()
+
+	vector<pair<CatalogVersion, string>> kept;
+	mt19937_64 random(7);
+	for (size_t round = 0; round < 600; ++round) {
+		size_t i = random() % IDS;
+		Course aCourse = MakeCourse(CourseId(i));
+		aCourse.courseName = "Version " + to_string(round);
+		switch (round % 50 == 49 ? 3 : random() % 3) {
+		case 0:
+		case 1:
+			tree.InsertCourse(aCourse);
+			break;
+		case 2:
+			tree.DeleteCourseWithDependencyCheck(aCourse.courseId);
+			break;
+		default: { //A load over the current courses, then a cascade
+			vector<Course> courses;
+			for (size_t n = 0; n < 20; ++n) {
+				courses.push_back(MakeCourse(CourseId(random() % IDS), n == 0 ? "" : courses.back().courseId));
+			}
+			string seed = courses.front().courseId;
+			tree.BulkLoad(courses); //Moves the courses out
+			vector<string> removed;
+			tree.DeleteCascade({ seed }, removed);
+			CHECK(!removed.empty() && removed.back() == seed);
+			break;
+		}
+		}
+		CHECK_VALID(tree);
+		CatalogVersion version = tree.Snapshot();
+		CHECK(version.Size() == tree.Size());
+		kept.emplace_back(version, Contents(tree));
+	}
+
+	for (const pair<CatalogVersion, string>& entry : kept) {
+		CHECK(listing(entry.first) == entry.second);
+	}
+	uint64_t newest = kept.back().first.Number();
+	CatalogVersion version;
+	CHECK(tree.Version(newest, version) && listing(version) == kept.back().second);
+	CHECK(tree.Version(newest - VERSION_HISTORY + 1, version));
+	CHECK(!tree.Version(newest - VERSION_HISTORY, version));
+	CHECK(!tree.Version(newest + 1, version));
+}
+
+/*
+ * Random courses with random prerequisites, some closing cycles, are added,
+ * replaced and deleted. Each refusal must match a brute-force search of the
+ * accepted edges, and the Pearce-Kelly order must stay valid throughout.
+ */
+void TestPrerequisiteOrder() {
+	const size_t IDS = 60;
+	BinarySearchTree tree;
+	unordered_map<string, Course> accepted;
+
+	//Does course (transitively) list target as a prerequisite?
+	function<bool(const string&, const string&)> dependsOn = [&](const string& course, const string& target) {
+		auto entry = accepted.find(course);
+		if (entry == accepted.end()) {
+			return false;
+		}
+		for (const string* preReq : { &entry->second.preReq1, &entry->second.preReq2 }) {
+			if (!preReq->empty() && (*preReq == target || dependsOn(*preReq, target))) {
+				return true;
+			}
+		}
+		return false;
+	};
+
+	mt19937_64 random(5);
+	size_t refused = 0;
+	for (size_t round = 0; round < 3000; ++round) {
+		string courseId = CourseId(random() % IDS);
+		if (random() % 4 == 0) {
+			bool deleted = tree.DeleteCourseWithDependencyCheck(courseId);
+			bool listed = false;
+			for (const auto& entry : accepted) {
+				listed = listed || entry.second.preReq1 == courseId || entry.second.preReq2 == courseId;
+			}
+			CHECK(deleted == (accepted.count(courseId) == 1 && !listed));
+			if (deleted) {
+				accepted.erase(courseId);
+			}
+		}
+		else {
+			Course aCourse = MakeCourse(courseId, random() % 3 ? CourseId(random() % IDS) : "", random() % 2 ? CourseId(random() % IDS) : "");
+			bool cycle = false;
+			for (const string* preReq : { &aCourse.preReq1, &aCourse.preReq2 }) {
+				cycle = cycle || (!preReq->empty() && (*preReq == courseId || dependsOn(*preReq, courseId)));
+			}
+			CHECK(tree.InsertCourse(aCourse) == !cycle);
+			if (cycle) {
+				++refused;
+			}
+			else {
+				accepted[courseId] = aCourse;
+			}
+		}
+		CHECK_VALID(tree);
+	}
+	CHECK(refused > 0);
+
+	vector<string> order;
+	CHECK(tree.Prerequisites().TopologicalOrder(order));
+	CHECK(order.size() == accepted.size());
+	unordered_map<string, size_t> position;
+	for (size_t i = 0; i < order.size(); ++i) {
+		position[order[i]] = i;
+	}
+	for (const auto& entry : accepted) {
+		for (const string* preReq : { &entry.second.preReq1, &entry.second.preReq2 }) {
+			CHECK(preReq->empty() || position.count(*preReq) == 0 || position[*preReq] < position[entry.first]);
+		}
+	}
+}
+
+/*
+ * Runs one script through BatchRunner on every kind of catalog, once with
+ * a catalog small enough that the adds take the BulkLoad() path and once
+ * with one large enough that they go in one InsertCourse() at a time,
+ * checking both give the same result lines
+ */
+void TestBatchRuns() {
+	const char* script =
+		"add,MATH100,Algebra\n"
+		"add,MATH200,Calculus,MATH100\n"
+		"add,CSCI300,Systems,NONE999\n"
+		"add,CSCI400,Compilers,CSCI300\n"
+		"add,LOOP100,Left,LOOP200\n"
+		"add,LOOP200,Right,LOOP100\n"
+		"add,PHYS200,Mechanics,XCS100\n"
+		"add,PHYS300,Waves,PHYS200\n"
+		"add,MATH100,Algebra I\n"
+		"delete,MATH100\n"
+		"delete,MATH200\n"
+		"delete,MATH200\n"
+		"delete,XCS100\n";
+	const string expected =
+		"add,MATH100,ok\n"
+		"add,MATH200,ok\n"
+		"add,CSCI300,error,missing prerequisite NONE999\n"
+		"add,CSCI400,error,missing prerequisite CSCI300\n"
+		"add,LOOP100,error,prerequisite cycle\n"
+		"add,LOOP200,error,prerequisite cycle\n"
+		"add,PHYS200,error,prerequisite cycle\n"
+		"add,PHYS300,error,missing prerequisite PHYS200\n"
+		"add,MATH100,ok\n"
+		"delete,MATH100,ok\n"
+		"delete,MATH200,ok\n"
+		"delete,MATH200,error,not found\n"
+		"delete,XCS100,ok\n";
+
+	for (size_t fill : { size_t(0), size_t(200) }) {
+		for (unique_ptr<CourseCatalog>& catalog : AllCatalogs()) {
+			catalog->InsertCourse(MakeCourse("XCS100", "PHYS200")); //PHYS200 is not a course, adding it with XCS100 closes a cycle
+			for (size_t i = 0; i < fill; ++i) {
+				catalog->InsertCourse(MakeCourse(CourseId(i)));
+			}
+			MemorySink out;
+			BatchRunner runner(catalog.get(), out);
+			CHECK(runner.Run(script, script + strlen(script)) == 0);
+			CHECK(out.Contents() == expected);
+			if (out.Contents() != expected) {
+				cerr << "  fill " << fill << ":\n" << out.Contents();
+			}
+			CHECK(catalog->Size() == fill);
+			for (const char* courseId : { "MATH100", "CSCI400", "LOOP100", "PHYS200", "PHYS300", "XCS100" }) {
+				CHECK(catalog->Search(courseId) == nullptr);
+			}
+			CHECK_VALID(*catalog);
+		}
+	}
+}
+
+/*
+ * Changes made through a LoggedCatalog are back after a restart: inserts,
+ * deletes, cascades, loads and a reload of the course file (logged as one
+ * R record, not a copy). A torn last record is dropped, a log that can not
+ * be opened is never replaced, and a log whose course file has changed is
+ * not replayed.
+ */
+void TestLogRecovery() {
+	string courseFile = TemporaryFileName("logged.csv");
+	string logFile = TemporaryFileName("logged.log");
+	auto write = [](const string& fileName, const string& text) {
+		ofstream(fileName, ios::binary) << text;
+	};
+	auto read = [](const string& fileName) {
+		ifstream in(fileName, ios::binary);
+		return string((istreambuf_iterator<char>(in)), istreambuf_iterator<char>());
+	};
+	string courses;
+	for (size_t i = 0; i < 50; ++i) {
+		courses += CourseId(i) + ",Course " + CourseId(i) + (i % 10 == 0 ? "" : "," + CourseId(i - 1)) + "\n";
+	}
+	write(courseFile, courses);
+
+	string expected;
+	{
+		LoggedCatalog logged(new BinarySearchTree(), logFile);
+		CHECK(logged.Recover(courseFile));
+		CHECK(logged.Size() == 50);
+		CHECK(logged.InsertCourse(MakeCourse("NEW100", CourseId(3))));
+		CHECK(!logged.InsertCourse(MakeCourse(CourseId(3), "NEW100"))); //Cycle, not logged
+		CHECK(logged.DeleteCourseWithDependencyCheck(CourseId(49)));
+		vector<string> removed;
+		logged.DeleteCascade({ CourseId(25) }, removed);
+		CHECK(removed.size() == 5);
+		vector<Course> batch = { MakeCourse("NEW200", "NEW100"), MakeCourse("NEW201") };
+		logged.BulkLoad(batch);
+		logged.LoadFile(courseFile); //Brings the deleted courses back
+		CHECK(logged.Size() == 53);
+		CHECK(logged.DeleteCourseWithDependencyCheck("NEW201"));
+		logged.Commit();
+		expected = Contents(logged);
+		CHECK_VALID(logged);
+	}
+	string logText = read(logFile);
+	CHECK(logText.find("R,") != string::npos);
+	CHECK(logText.size() < courses.size()); //The reload is not a copy of the file
+
+	for (int restart = 0; restart < 2; ++restart) {
+		LoggedCatalog logged(new CourseBTree(), logFile);
+		CHECK(logged.Recover(courseFile));
+		CHECK(Contents(logged) == expected);
+		CHECK_VALID(logged);
+		if (restart == 0) {
+			write(logFile, read(logFile) + "I,TORN,Torn"); //A crash mid-record
+		}
+	}
+	CHECK(read(logFile) == logText); //The torn record was cut off
+
+	//A log that exists but can not be opened is an error, and nothing is created
+	{
+		LoggedCatalog logged(new BinarySearchTree(), courseFile + "/not-a-directory.log");
+		CHECK(!logged.Recover(courseFile));
+		CHECK(logged.Size() == 0);
+	}
+
+	//An edited course file is not the base the log was written against
+	write(courseFile, courses + "EXTRA1,Extra\n");
+	{
+		LoggedCatalog logged(new BinarySearchTree(), logFile);
+		CHECK(!logged.Recover(courseFile));
+	}
+	CHECK(read(logFile) == logText);
+	remove(courseFile.c_str());
+	remove(logFile.c_str());
+}
+
+/*
+ * Inserts and erases random IDs in a CourseHashIndex, checking after every
+ * change that backward-shift deletes leave no entry cut off from its home
+ * slot and that every lookup agrees with a reference set
+ */
+void TestHashIndex() {
+	const size_t IDS = 300;
+	vector<Course> courses(IDS);
+	for (size_t i = 0; i < IDS; ++i) {
+		courses[i] = MakeCourse(CourseId(i));
+	}
+	CourseHashIndex index;
+	vector<bool> indexed(IDS, false);
+	size_t count = 0;
+	mt19937_64 random(11);
+	for (size_t round = 0; round < 6000; ++round) {
+		size_t i = random() % (round < 3000 ? IDS : IDS / 3); //Later rounds churn a crowded corner
+		if (random() % 2 == 0) {
+			index.Insert(&courses[i]);
+			count += indexed[i] ? 0 : 1;
+			indexed[i] = true;
+		}
+		else {
+			index.Erase(courses[i].courseId);
+			count -= indexed[i] ? 1 : 0;
+			indexed[i] = false;
+		}
+		string problem;
+		CHECK(index.Verify(count, problem));
+		if (round % 97 == 0) {
+			for (size_t j = 0; j < IDS; ++j) {
+				CHECK(index.Find(courses[j].courseId) == (indexed[j] ? &courses[j] : nullptr));
+			}
+		}
+	}
+}
+
+/*
+ * SearchMany() on the tree, stale and then frozen, must answer like
+ * Search() for IDs that are present and absent, in input order
+ */
+void TestSearchMany() {
+	BinarySearchTree tree;
+	for (size_t i = 0; i < 500; i += 2) {
+		tree.InsertCourse(MakeCourse(CourseId(i)));
+	}
+	vector<string> ids;
+	for (size_t i = 0; i < 600; ++i) {
+		ids.push_back(CourseId((i * 37) % 600));
+	}
+	ids.push_back("");
+	ids.push_back("A_LONG_COURSE_ID_PAST_THE_PACKED_KEY");
+	vector<string_view> views(ids.begin(), ids.end());
+
+	for (size_t pass = 0; pass < 4; ++pass) {
+		if (pass == 2) {
+			tree.Freeze();
+		}
+		if (pass == 3) { //A change makes the frozen copy stale again
+			tree.InsertCourse(MakeCourse(CourseId(1)));
+		}
+		vector<const Course*> results;
+		tree.SearchMany(views, results);
+		CHECK(results.size() == views.size());
+		for (size_t j = 0; j < views.size(); ++j) {
+			CHECK(results[j] == tree.Search(views[j]));
+		}
+	}
+	CHECK(tree.Search(CourseId(1)) != nullptr);
+	CHECK_VALID(tree);
+}
+
+/*
+ * Cascades on every kind of catalog, one small enough to delete course by
+ * course and one large enough to rebuild, checking the removed list
+ * (exactly the closure, dependents first) and what is left
+ */
+void TestDeleteCascade() {
+	const size_t CHAINS = 20, LENGTH = 20; //Course i needs course i - 1 within its chain
+	for (unique_ptr<CourseCatalog>& catalog : AllCatalogs()) {
+		vector<Course> courses;
+		for (size_t i = 0; i < CHAINS * LENGTH; ++i) {
+			courses.push_back(MakeCourse(CourseId(i), i % LENGTH == 0 ? "" : CourseId(i - 1)));
+		}
+		catalog->BulkLoad(courses);
+		size_t left = CHAINS * LENGTH;
+
+		vector<vector<string>> cascades = {
+			{ CourseId(5), "NOSUCH1" },                                          //15 courses, one at a time
+			{ CourseId(LENGTH), CourseId(3 * LENGTH), CourseId(4 * LENGTH + 7) }, //53 courses, rebuilt
+		};
+		for (const vector<string>& seeds : cascades) {
+			vector<string> removed;
+			catalog->DeleteCascade(seeds, removed);
+			size_t expected = 0;
+			for (const string& seed : seeds) {
+				if (seed != "NOSUCH1") {
+					size_t i = stoul(seed.substr(1));
+					expected += LENGTH - i % LENGTH;
+				}
+			}
+			CHECK(removed.size() == expected);
+			for (size_t r = 0; r < removed.size(); ++r) {
+				size_t i = stoul(removed[r].substr(1));
+				CHECK(catalog->Search(removed[r]) == nullptr);
+				if (i % LENGTH != LENGTH - 1) { //Its dependent, if removed too, came first
+					auto dependent = find(removed.begin(), removed.end(), CourseId(i + 1));
+					CHECK(dependent == removed.end() || dependent < removed.begin() + r);
+				}
+			}
+			left -= removed.size();
+			CHECK(catalog->Size() == left);
+			CHECK_VALID(*catalog);
+		}
+		CHECK(catalog->Search(CourseId(4)) != nullptr);
+		CHECK(catalog->Search(CourseId(4 * LENGTH + 6)) != nullptr);
+	}
+}
+
+struct TestCase {
+	const char* name;
+	void (*run)();
+};
+
+const TestCase TESTS[] = {
+	{ "AvlInsertDelete", TestAvlInsertDelete },
+	{ "AvlOrderStatistics", TestAvlOrderStatistics },
+	{ "DependencyCheck", TestDependencyCheck },
+	{ "BulkLoadDuplicates", TestBulkLoadDuplicates },
+	{ "BTreeSplitMerge", TestBTreeSplitMerge },
+	{ "SnapshotRoundTrip", TestSnapshotRoundTrip },
+	{ "ConcurrentReaders", TestConcurrentReaders },
+	{ "PersistentVersions", TestPersistentVersions },
+	{ "PrerequisiteOrder", TestPrerequisiteOrder },
+	{ "BatchRuns", TestBatchRuns },
+	{ "LogRecovery", TestLogRecovery },
+	{ "HashIndex", TestHashIndex },
+	{ "SearchMany", TestSearchMany },
+	{ "DeleteCascade", TestDeleteCascade },
+};
+
+int main() {
+	cout.setstate(ios::failbit); //Catalog messages are not part of the results
+	for (const TestCase& test : TESTS) {
+		size_t failedBefore = checksFailed;
+		test.run();
+		cerr << (checksFailed == failedBefore ? "PASS " : "FAIL ") << test.name << endl;
+	}
+	cout.clear();
+	cerr << checksRun << " checks, " << checksFailed << " failed" << endl;
+	return checksFailed == 0 ? 0 : 1;
+}